@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace crawler {
+
+// A thread-safe FIFO with a fixed capacity. Producers block while it is full,
+// which is what pushes back on them when the consumer falls behind.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {}
+
+  // Adds an item, blocking while the queue is full. Returns false if the
+  // queue has been closed.
+  bool Push(T item) {
+    std::unique_lock lock(mutex);
+    not_full.wait(lock, [this] { return is_closed || items.size() < capacity; });
+    if (is_closed) {
+      return false;
+    }
+    items.push_back(std::move(item));
+    not_empty.notify_one();
+    return true;
+  }
+
+  // Removes the oldest item, waiting until one is available, the queue is
+  // closed or `deadline` passes. Items pushed before Close() are still
+  // returned.
+  std::optional<T> PopUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock lock(mutex);
+    not_empty.wait_until(lock, deadline,
+                         [this] { return is_closed || !items.empty(); });
+    if (items.empty()) {
+      return std::nullopt;
+    }
+    T item = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return item;
+  }
+
+  // Wakes up every waiter; no item can be pushed afterwards.
+  void Close() {
+    std::lock_guard lock(mutex);
+    is_closed = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+  bool IsClosed() const {
+    std::lock_guard lock(mutex);
+    return is_closed;
+  }
+
+  bool IsFull() const {
+    std::lock_guard lock(mutex);
+    return items.size() >= capacity;
+  }
+
+private:
+  const std::size_t capacity;
+  mutable std::mutex mutex;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+  std::deque<T> items;
+  bool is_closed = false;
+};
+
+} // namespace crawler
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace crawler {
+
+// What a page's text is compared on to find duplicates. The text is
+// normalized first: markup, scripts and styles are dropped, and the words
+// are lowercased and separated by single spaces.
+struct ContentSignature {
+  // Hash128 of the normalized text, equal for exact duplicates
+  std::pair<std::uint64_t, std::uint64_t> text_hash{};
+  // SimHash of the words of the text, each counted as often as it occurs,
+  // within a few bits of each other for near duplicates
+  std::uint64_t simhash = 0;
+  std::uint32_t word_count = 0;
+};
+
+// The signature of a page in the index, as it is persisted. The page is
+// known by the fingerprint of its URL, as in the known link set.
+struct IndexedPageSignature {
+  std::uint64_t fingerprint;
+  ContentSignature signature;
+};
+
+// Computes the signature of a page's text, fed in arbitrary chunks as the
+// page is downloaded. Only the normalized text is buffered.
+class ContentSignatureBuilder {
+public:
+  ContentSignatureBuilder();
+
+  // Feeds text that continues the previous chunk; a word may span chunks.
+  void Feed(std::string_view text);
+
+  // Ends the current word, at markup between two runs of text.
+  void BreakWord();
+
+  ContentSignature Finish();
+
+  // Resets the builder so it can be reused for another page.
+  void Reset();
+
+private:
+  std::string normalized_text;
+  bool is_in_word;
+  std::size_t word_offset;
+  std::uint32_t word_count;
+  // Sum, over the words, of +1 or -1 for every bit of their hash
+  std::array<std::int32_t, 64> bit_weights;
+
+  void endWord();
+};
+
+} // namespace crawler
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "content_signature.hpp"
+
+namespace crawler {
+
+// Finds the pages whose text is already in the index, so that mirrors,
+// session id URLs and printer-friendly variants are stored once.
+//
+// Exact duplicates are found by their text hash. Near duplicates are pages
+// whose SimHash differs by at most kMaxDistance bits; the SimHash is cut
+// into kMaxDistance + 1 bands, at least one of which two such pages must
+// share, and every band has a table from its value to the pages with it.
+//
+// Pages are only known by the fingerprint of their URL, so every indexed
+// page costs a fixed few dozen bytes whatever its URL; the URL of a
+// canonical page is looked up in the database when an alias is recorded.
+class DuplicateDetector {
+public:
+  // Starts from the signatures of the pages already in the index.
+  explicit DuplicateDetector(std::vector<IndexedPageSignature> indexed_pages);
+
+  // Returns the URL fingerprint of the indexed page that the page at `url`
+  // duplicates. Otherwise, the page is to be indexed and is added as the
+  // canonical page of its text. A page that is already indexed is never
+  // reported as a duplicate, only has its signature updated.
+  std::optional<std::uint64_t> FindCanonicalPage(
+      std::string_view url, const ContentSignature &signature);
+
+private:
+  static constexpr int kMaxDistance = 3;
+  static constexpr int kBandCount = kMaxDistance + 1;
+  static constexpr int kBandBits = 64 / kBandCount;
+
+  struct PairHash {
+    std::size_t operator()(
+        const std::pair<std::uint64_t, std::uint64_t> &hash) const {
+      return static_cast<std::size_t>(hash.first);
+    }
+  };
+
+  std::vector<IndexedPageSignature> pages;
+  // Page index by URL fingerprint
+  std::unordered_map<std::uint64_t, std::uint32_t> page_ids;
+  std::unordered_map<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t,
+                     PairHash>
+      text_hashes;
+  // Pages by the value of each band of their SimHash
+  std::array<std::unordered_map<std::uint16_t, std::vector<std::uint32_t>>,
+             kBandCount>
+      bands;
+
+  std::optional<std::uint32_t> findDuplicate(const ContentSignature &signature);
+
+  void addPage(std::uint32_t page_id,
+               const std::optional<ContentSignature> &previous_signature);
+
+  static std::uint16_t getBand(std::uint64_t simhash, int band);
+};
+
+} // namespace crawler
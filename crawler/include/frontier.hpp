@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "web_crawler.hpp"
+
+namespace crawler {
+
+// A robots.txt policy as it is persisted: the file fetched for a host, or
+// no content if the host has none (everything is allowed).
+struct RobotsTxtRecord {
+  std::string host;
+  std::optional<std::string> content;
+  // Seconds since the Unix epoch
+  std::int64_t fetched_at;
+};
+
+// What is kept about a fetched page to revisit it: the validators and hash
+// of its last fetch, which tell whether it has changed since, and the
+// history its change rate is estimated from.
+struct PageFetchRecord {
+  std::string url;
+  HttpValidators validators;
+  // First half of the page body's Hash128
+  std::uint64_t content_hash;
+  // Seconds since the Unix epoch
+  std::int64_t fetched_at;
+  std::int64_t next_fetch_at;
+  // Number of revisits that found the page changed, and the time spanned by
+  // every revisit so far
+  std::int64_t change_count;
+  std::int64_t observed_seconds;
+};
+
+// Changes to the crawl frontier, which the index writer persists in the
+// same transaction as the pages they come with. Links are identified by
+// their fingerprint in UrlFingerprintSet.
+struct FrontierUpdate {
+  // Links queued for the first time, which also become known
+  std::vector<std::string> queued_links;
+  // Fingerprints of links that have left the queue: fetched, disallowed by
+  // robots.txt, or dropped with their host
+  std::vector<std::uint64_t> done_links;
+  std::vector<RobotsTxtRecord> robots_txts;
+  std::vector<PageFetchRecord> fetched_pages;
+
+  bool IsEmpty() const {
+    return queued_links.empty() && done_links.empty() &&
+           robots_txts.empty() && fetched_pages.empty();
+  }
+};
+
+// The persisted frontier, read back when the crawler starts, from which a
+// crawl resumes where it stopped.
+struct FrontierSnapshot {
+  // Fingerprints of every link ever queued
+  std::vector<std::uint64_t> known_links;
+  // Links still to fetch, in the order they were queued
+  std::vector<std::string> queued_links;
+  std::vector<RobotsTxtRecord> robots_txts;
+};
+
+} // namespace crawler
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "content_signature.hpp"
+
+namespace crawler {
+
+// A byte range of a document, as an offset from its first byte.
+struct TextSpan {
+  std::size_t offset;
+  std::size_t length;
+};
+
+// Single-pass HTML tokenizer that locates the title, the <base href> and the
+// followable <a href> links of a page, and computes the signature of its
+// text. The body can be fed in arbitrary chunks as it is downloaded; all
+// tokenizer state is kept between calls.
+//
+// Nothing is copied out of the document: results are spans of the raw,
+// undecoded markup, to be resolved against the complete body.
+class HtmlExtractor {
+public:
+  HtmlExtractor();
+
+  // Feeds the next chunk of the document.
+  void Feed(std::string_view chunk);
+
+  // Resets the extractor so it can be reused for another document.
+  void Reset();
+
+  std::optional<TextSpan> TakeTitle();
+
+  std::optional<TextSpan> TakeBaseHref();
+
+  std::vector<TextSpan> TakeLinks();
+
+  ContentSignature TakeContentSignature();
+
+private:
+  enum class State {
+    Text,
+    TagOpen,
+    EndTagOpen,
+    TagName,
+    BeforeAttributeName,
+    AttributeName,
+    AfterAttributeName,
+    BeforeAttributeValue,
+    AttributeValueQuoted,
+    AttributeValueUnquoted,
+    SelfClosingTag,
+    MarkupDeclaration,
+    Comment,
+    BogusComment,
+    RawText,
+  };
+
+  State state;
+  // Offset of the current chunk in the document, and its first byte.
+  std::size_t chunk_offset;
+  const char *chunk_begin;
+
+  bool is_end_tag;
+  char quote_char;
+  // Number of dashes seen before the current position in a comment, or of
+  // characters of "--" seen after "<!".
+  int dash_count;
+  // Number of characters of "</" + raw_text_tag matched so far in raw text,
+  // and the offset of the '<' that started the match.
+  std::size_t raw_text_match;
+  std::size_t raw_text_match_offset;
+
+  std::string tag_name;
+  std::string attribute_name;
+  std::size_t attribute_value_offset;
+  // Only the rel attribute needs its value copied out.
+  std::string rel;
+  std::optional<TextSpan> href;
+
+  // Element whose content is not markup (script, style, title, textarea).
+  std::string raw_text_tag;
+  bool is_in_title;
+  std::size_t title_offset;
+
+  std::optional<TextSpan> title;
+  std::optional<TextSpan> base_href;
+  std::vector<TextSpan> links;
+  // Fed the text outside of tags and raw text elements
+  ContentSignatureBuilder signature_builder;
+
+  std::size_t offsetOf(const char *it) const;
+
+  void feedRawText(const char *&it, const char *end);
+
+  void finishAttribute(const char *value_end);
+
+  void finishTag(const char *it);
+
+  static void appendLower(std::string &target, char c, std::size_t limit);
+};
+
+} // namespace crawler
@@ -1,6 +1,15 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
 #include <string>
+#include <thread>
 
+#include "body_codec.hpp"
+#include "bounded_queue.hpp"
+#include "content_signature.hpp"
+#include "frontier.hpp"
 #include "options.hpp"
 #include "web_crawler.hpp"
 
@@ -16,16 +25,162 @@ struct SQLiteStmtDeleter {
   void operator()(sqlite3_stmt *stmt) const;
 };
 
+// Writes pages to the index on a dedicated thread, so FTS tokenization and
+// disk I/O overlap with fetching instead of stalling it.
+//
+// The FTS table is given the text of a page rather than its markup, which
+// is compressed into a table of its own, to re-index pages from. Bodies
+// are compressed with a dictionary trained on the first pages stored.
+//
+// The crawl frontier is persisted in the same database and the same
+// transactions: a page and the links found on it are committed together, so
+// a crawler that restarts resumes from exactly what was stored. So are the
+// signatures of indexed pages, and the duplicates found instead of them.
 class IndexWriter {
 public:
+  // Opens the database and reads the frontier persisted by a previous run.
   explicit IndexWriter(
       std::unique_ptr<crawler::DatabaseOptions> db_options);
+  // Writes and commits every queued page, then stops the writer thread.
   ~IndexWriter();
 
-  bool InsertPage(const std::string &url, const PageResult &page_result);
+  // Returns the frontier read when the writer was created, leaving an empty
+  // one behind.
+  FrontierSnapshot TakeRestoredFrontier();
+
+  // Returns the signatures of the indexed pages read when the writer was
+  // created, leaving none behind.
+  std::vector<IndexedPageSignature> TakeRestoredSignatures();
+
+  // Hands the page over to the writer thread, along with the frontier
+  // changes of its fetch, blocking while the queue is full. Returns false if
+  // the writer has been stopped.
+  bool EnqueuePage(std::string url, PageResult page_result,
+                   FrontierUpdate frontier_update);
+
+  // Records a page as an alias of the indexed page it duplicates, known by
+  // its URL fingerprint, instead of indexing it, like EnqueuePage().
+  bool EnqueueDuplicate(std::string url, std::uint64_t canonical_fingerprint,
+                        FrontierUpdate frontier_update);
+
+  // Hands frontier changes that do not come with a page over to the writer
+  // thread, like EnqueuePage().
+  bool EnqueueFrontierUpdate(FrontierUpdate frontier_update);
+
+  // True while the queue is full; the crawler should stop starting new
+  // fetches until the writer catches up.
+  bool IsBacklogged() const;
+
+  // Waits until every page queued so far has been written and committed.
+  bool Drain();
 
 private:
+  // A page (or the page it duplicates) and frontier changes to write, or a
+  // drain request when `drained` is set.
+  struct WriteRequest {
+    std::string url;
+    std::optional<PageResult> page_result;
+    std::optional<std::uint64_t> canonical_fingerprint;
+    FrontierUpdate frontier_update;
+    std::shared_ptr<std::promise<bool>> drained;
+  };
+
   std::unique_ptr<sqlite3, SQLiteDbDeleter> db;
   std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> insert_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> begin_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> commit_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> bump_generation_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> insert_known_link_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> queue_link_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> dequeue_link_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> upsert_robots_txt_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> upsert_fetched_page_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> upsert_signature_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> upsert_alias_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> delete_alias_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> upsert_body_stmt;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> insert_dictionary_stmt;
+
+  FrontierSnapshot restored_frontier;
+  std::vector<IndexedPageSignature> restored_signatures;
+
+  indexer::BodyCompressor body_compressor;
+  // Dictionary the bodies are compressed with, none until it is trained
+  std::optional<std::int64_t> dictionary_id;
+  std::size_t dictionary_sample_pages;
+  std::vector<std::string> dictionary_samples;
+  // Reused for every page
+  std::string compressed_body;
+
+  int batch_size;
+  std::chrono::milliseconds batch_interval;
+  int batch_page_count = 0;
+  // Whether the open batch writes pages or aliases, and not only frontier
+  // changes
+  bool has_index_changes = false;
+  bool is_in_transaction = false;
+  std::chrono::steady_clock::time_point batch_start_time;
+
+  // Only the writer thread touches the database once it is started.
+  BoundedQueue<WriteRequest> write_queue;
+  std::thread writer_thread;
+
+  void applyPragmas(const DatabaseOptions &db_options);
+
+  // Creates the table holding the index generation, which every committed
+  // batch increments so readers can tell that their cached results are stale.
+  void createGenerationTable();
+
+  // Creates the tables holding the frontier: every known link, the queue of
+  // links to fetch, the robots.txt of every host, and the fetch history of
+  // every page, from which pages are revisited.
+  void createFrontierTables();
+
+  // Creates the tables holding the signature of every indexed page, and the
+  // page every duplicate was found to be an alias of.
+  void createDuplicateTables();
+
+  // Creates the tables holding the compressed body of every indexed page,
+  // and the dictionaries they are compressed with.
+  void createBodyTables();
+
+  FrontierSnapshot loadFrontier();
+
+  std::vector<IndexedPageSignature> loadSignatures();
+
+  // Makes the latest trained dictionary the one bodies are compressed with.
+  void loadDictionary();
+
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>
+  prepareStatement(const char *sql);
+
+  void writerLoop();
+
+  // Writes the request in the open batch, starting one if needed. It becomes
+  // durable once the batch is committed.
+  bool write(WriteRequest request);
+
+  // Takes ownership of the page so its body is bound without being copied.
+  bool insertPage(const std::string &url, PageResult page_result);
+
+  bool insertBody(const std::string &url, std::string_view body);
+
+  bool insertAlias(const std::string &url,
+                   std::uint64_t canonical_fingerprint);
+
+  // Trains the dictionary once enough pages have been sampled, and commits
+  // it right away, before any body compressed with it.
+  void trainDictionaryIfDue();
+
+  bool applyFrontierUpdate(const FrontierUpdate &frontier_update);
+
+  bool beginBatch();
+
+  // Commits the open batch if it has been open for longer than the batch
+  // interval.
+  bool flushIfDue();
+
+  // Commits the open batch, if any.
+  bool flush();
 };
 } // namespace crawler
@@ -2,51 +2,142 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "config.hpp"
+#include "frontier.hpp"
+#include "options.hpp"
 #include "robots_parser.hpp"
+#include "url.hpp"
+#include "url_fingerprint_set.hpp"
+#include "web_crawler.hpp"
 
 namespace crawler {
 
 class LinkManager {
 public:
+  // Starts from the frontier persisted by a previous run, if it has one,
+  // then queues the seed links that are not known yet. Restored links that
+  // are no longer based on a seed link are dropped, and robots.txt files
+  // older than their cache TTL are fetched again.
   LinkManager(const std::vector<std::string> &seed_links,
-              const int default_delay);
+              const CrawlOptions &crawl_options,
+              FrontierSnapshot restored_frontier = {});
 
-  void AddDiscoveredLinks(const std::vector<std::string> &links,
-                          const std::string &source_link);
+  // Queues the links (and redirect target) of a fetched page. Relative links
+  // are resolved against the page's <base href> when it declared one, and
+  // against `source_link` otherwise.
+  void AddDiscoveredLinks(const PageResult &page_result,
+                          const NormalizedUrl &source_link);
 
-  void MarkLinkAsVisited(const std::string &link);
+  // Queues a page that has been fetched before to be fetched again, like a
+  // new link but without recording it in the frontier: revisits are
+  // scheduled from the fetch history instead. Returns false if the link is
+  // invalid or no longer based on a seed link.
+  bool QueueRevisit(std::string_view link);
+
+  // Records that the fetch of a link handed out by GetNextLinkToVisit() has
+  // finished. The link's host is scheduled again once its delay has passed.
+  void MarkLinkAsVisited(const NormalizedUrl &link);
+
+  // Returns the changes to the frontier since the last call, to be
+  // persisted.
+  FrontierUpdate TakeFrontierUpdate();
 
   bool HasLinksToVisit() const;
 
-  std::string GetNextLinkToVisit();
+  // Returns the next fetch for a host that may be contacted right now, or
+  // std::nullopt if every host with queued links is still waiting for its
+  // delay (or has a fetch in flight). A host whose robots.txt is missing or
+  // expired gets its robots.txt fetched before any of its links.
+  //
+  // The host is not handed out again until MarkLinkAsVisited() (for pages)
+  // or HandleRobotsTxt() (for robots.txt) is called for the fetch.
+  //
+  // Among the hosts that may be contacted, those for which
+  // `has_warm_connection` is true go first, saving a DNS lookup and a
+  // handshake; a host without one is only passed over for a short while.
+  std::optional<FetchRequest> GetNextLinkToVisit(
+      const std::function<bool(HostId)> &has_warm_connection = {});
+
+  // Applies a completed robots.txt fetch to its host, following RFC 9309: a
+  // 4xx response allows everything, while a 5xx response or network error
+  // keeps the host's links parked until a later fetch succeeds.
+  void HandleRobotsTxt(const FetchResult &fetch_result);
 
-  void RequeLink(const std::string &link);
+  // Earliest time at which GetNextLinkToVisit() may return a link, or
+  // std::nullopt if no host is scheduled.
+  std::optional<std::chrono::steady_clock::time_point>
+  GetNextVisitTime() const;
 
-  bool IsCrawlAllowed(const std::string &link) const;
+  bool IsCrawlAllowed(const NormalizedUrl &link) const;
 
-  bool HasEnoughDelay(const std::string &link) const;
+  // The set of every link seen so far, for its size and false positive rate.
+  const UrlFingerprintSet &GetKnownLinks() const;
 
 private:
+  using ScheduledHost = std::pair<std::chrono::steady_clock::time_point, HostId>;
+
+  // Links waiting to be fetched from a single host.
+  struct HostQueue {
+    std::queue<NormalizedUrl> links;
+    bool is_scheduled = false;
+    bool is_in_flight = false;
+    // When robots.txt has to be fetched (again). The default means right
+    // away, so links of a new host are parked until its robots.txt is known.
+    std::chrono::steady_clock::time_point robots_txt_expiry;
+    int robots_txt_failures = 0;
+  };
+
   int default_delay;
-  std::unordered_set<std::string> seed_links;
-  std::unordered_set<std::string> all_known_links;
-  std::queue<std::string> links_to_visit;
-  std::unordered_map<std::string, std::unique_ptr<RobotsParser>>
-      robots_txt_parsers;
-  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+  std::chrono::seconds robots_txt_cache_ttl;
+  std::size_t links_to_visit_count = 0;
+  HostTable host_table;
+  std::vector<std::string> seed_links;
+  UrlFingerprintSet all_known_links;
+  std::unordered_map<HostId, HostQueue> host_queues;
+  // Min-heap of hosts keyed on the time their next fetch is allowed. A host
+  // is in the heap at most once, and only while it has queued links and no
+  // fetch in flight.
+  std::priority_queue<ScheduledHost, std::vector<ScheduledHost>,
+                      std::greater<ScheduledHost>>
+      host_schedule;
+  std::unordered_map<HostId, std::unique_ptr<RobotsParser>> robots_txt_parsers;
+  std::unordered_map<HostId, std::chrono::steady_clock::time_point>
       visited_hosts;
+  FrontierUpdate frontier_update;
+
+  void addDiscoveredLink(std::string_view link,
+                         const ada::url_aggregator &base_url);
+
+  void restoreFrontier(FrontierSnapshot restored_frontier);
+
+  // Queues a link seen for the first time, and records it for persistence.
+  void queueNewLink(NormalizedUrl link);
+
+  void enqueueLink(NormalizedUrl link);
+
+  void markHostAsVisited(HostId host_id);
+
+  // Returns the next fetch for a host taken off the schedule, or
+  // std::nullopt if every queued link of the host is disallowed.
+  std::optional<FetchRequest>
+  takeNextFetch(HostId host_id, std::chrono::steady_clock::time_point now);
+
+  void scheduleHost(HostId host_id, HostQueue &host_queue);
 
-  bool isRelativeLink(const std::string &link) const;
+  std::chrono::steady_clock::time_point
+  getNextAllowedVisit(HostId host_id) const;
 
-  bool isBasedOnSeedLink(const std::string &link) const;
+  bool isBasedOnSeedLink(std::string_view link) const;
 };
 
 } // namespace crawler
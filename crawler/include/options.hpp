@@ -12,6 +12,31 @@ public:
   CrawlOptions(int default_delay);
 
   int default_delay;
+  int max_concurrent_requests;
+  int known_links_memory_limit_mb;
+  int robots_txt_cache_ttl;
+  // A page is revisited between revisit_min_interval and
+  // revisit_max_interval seconds after its last fetch, depending on how
+  // often it has been seen changing. At most revisits_per_minute revisits
+  // are started per minute; 0 disables revisits.
+  int revisit_min_interval;
+  int revisit_max_interval;
+  int revisits_per_minute;
+  // A download is aborted once its body, decompressed, grows past
+  // max_body_size_kb. Fetches are given connect_timeout seconds to connect
+  // and request_timeout seconds in all, and are aborted after transferring
+  // less than low_speed_limit bytes per second for low_speed_time seconds.
+  int max_body_size_kb;
+  int connect_timeout;
+  int request_timeout;
+  int low_speed_limit;
+  int low_speed_time;
+  // Up to max_cached_connections idle connections are kept open, and reused
+  // for connection_max_idle seconds. Resolved host names are reused for
+  // dns_cache_timeout seconds.
+  int max_cached_connections;
+  int connection_max_idle;
+  int dns_cache_timeout;
 };
 
 class DatabaseOptions {
@@ -22,6 +47,21 @@ public:
 
   std::string db_path;
   std::string fts_html_ext_path;
+  // Pages are written in transactions of up to batch_size pages, committed
+  // at the latest batch_interval_ms after their first page.
+  int batch_size;
+  int batch_interval_ms;
+  // Number of fetched pages that may wait for the writer thread before the
+  // crawler stops fetching new ones.
+  int queue_capacity;
+  // Page bodies are compressed at compression_level (1-9), with a
+  // dictionary trained on the first dictionary_sample_pages pages stored
+  // (0 for no dictionary).
+  int compression_level;
+  int dictionary_sample_pages;
+  std::string synchronous;
+  int cache_size_kb;
+  int mmap_size_mb;
 };
 
 class Options {
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "frontier.hpp"
+#include "index_writer.hpp"
+#include "options.hpp"
+#include "web_crawler.hpp"
+
+namespace crawler {
+
+// Decides when fetched pages are fetched again.
+//
+// Every page has a change rate estimated from its history: the number of
+// revisits that found it changed, over the time those revisits spanned. A
+// page is revisited about once per expected change, within the configured
+// bounds, so pages that change often are checked often and pages that never
+// do drift towards the longest interval. Revisits are conditional requests,
+// and a page whose body hashes the same as last time is not indexed again.
+//
+// Only the fingerprint and due time of every page are kept in memory; the
+// rest of the history is read from the database, on a connection of its
+// own, when a page comes due.
+class RevisitScheduler {
+public:
+  // Schedules every page fetched by previous runs. Throws if the database
+  // cannot be read.
+  RevisitScheduler(const std::string &db_path,
+                   const CrawlOptions &crawl_options);
+
+  // Returns the URLs of the pages that are due, as many as the revisit budget
+  // allows right now. Each is handed out once, until HandleFetch() is called
+  // for it.
+  std::vector<std::string> TakeDueRevisits();
+
+  // True while pages are due, whether or not the budget allows revisiting
+  // them yet.
+  bool HasDueRevisits() const;
+
+  // Forgets a page handed out by TakeDueRevisits() that cannot be revisited,
+  // because its URL is no longer based on a seed link. It is not scheduled
+  // again for the rest of the run.
+  void DropRevisit(std::string_view link);
+
+  // Makes the request for a page being revisited conditional on the
+  // validators of its last fetch.
+  void AddValidators(FetchRequest &request) const;
+
+  // Records a page fetch and schedules the next one. Returns true if the
+  // page is new or has changed since its last fetch, and so has to be
+  // written to the index.
+  bool HandleFetch(const FetchResult &fetch_result);
+
+  // Returns the fetch records since the last call, to be persisted.
+  std::vector<PageFetchRecord> TakeFetchedPages();
+
+private:
+  using ScheduledPage = std::pair<std::int64_t, std::uint64_t>;
+
+  bool is_enabled;
+  std::chrono::seconds min_interval;
+  std::chrono::seconds max_interval;
+  // Token bucket holding up to a minute of revisits
+  double revisits_per_minute;
+  double available_revisits;
+  std::chrono::steady_clock::time_point last_refill_time;
+
+  std::unique_ptr<sqlite3, SQLiteDbDeleter> db;
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> select_page_stmt;
+  // Min-heap of pages keyed on the time they are due, in seconds since the
+  // Unix epoch. Pages being revisited are not in it.
+  std::priority_queue<ScheduledPage, std::vector<ScheduledPage>,
+                      std::greater<ScheduledPage>>
+      page_schedule;
+  // Last fetch of the pages being revisited, by fingerprint
+  std::unordered_map<std::uint64_t, PageFetchRecord> revisits_in_flight;
+  std::vector<PageFetchRecord> fetched_pages;
+
+  void loadSchedule();
+
+  std::optional<PageFetchRecord> loadPage(std::uint64_t fingerprint);
+
+  // Time until the next visit of a page with the given history
+  std::chrono::seconds getRevisitInterval(const PageFetchRecord &page) const;
+
+  void schedulePage(PageFetchRecord page, std::int64_t now);
+};
+
+} // namespace crawler
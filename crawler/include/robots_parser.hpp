@@ -1,17 +1,84 @@
 // SPDX-License-Identifier: AGPL-3.0-only
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace crawler {
 
+// Allow and disallow patterns of a group, compiled for matching. Every
+// pattern is a path in one trie, where a '*' is an edge to a node that loops
+// on any character. The trie is run as an automaton along the path, once,
+// with the set of nodes the path so far leads to: without wildcards that is
+// a single node, and it never holds more than the nodes below a '*', so a
+// check costs O(path length * that number) whatever the number of rules,
+// without backtracking. Matching never allocates.
+class PathRules {
+public:
+  void AddPattern(std::string_view pattern, bool is_allow);
+
+  // Flattens the trie. Must be called once all patterns are added.
+  void Compile();
+
+  // Applies RFC 9309: the longest matching pattern wins, and allow wins over
+  // disallow for patterns of the same length. No match means allowed.
+  bool IsAllowed(std::string_view path) const;
+
+private:
+  static constexpr std::uint32_t kNoNode = UINT32_MAX;
+
+  // Flags of a trie node that ends one or more patterns.
+  static constexpr std::uint8_t kAllowPrefix = 1;
+  static constexpr std::uint8_t kDisallowPrefix = 2;
+  static constexpr std::uint8_t kAllowExact = 4;    // Pattern ended with '$'
+  static constexpr std::uint8_t kDisallowExact = 8; // Pattern ended with '$'
+  // Reached through a '*', and so matches any run of characters.
+  static constexpr std::uint8_t kWildcard = 16;
+
+  struct Node {
+    std::uint32_t first_edge = 0;
+    std::uint32_t edge_count = 0;
+    // Child through a '*' edge, which also matches no character at all
+    std::uint32_t wildcard_child = kNoNode;
+    // Length of the patterns ending here, '*' included
+    std::uint32_t length = 0;
+    std::uint8_t flags = 0;
+  };
+
+  struct Edge {
+    char label;
+    std::uint32_t child;
+  };
+
+  std::vector<Node> nodes{Node{}};
+  std::vector<Edge> edges;
+  // Children of each node while patterns are being added.
+  std::vector<std::map<char, std::uint32_t>> pending_children{{}};
+  // Sets of nodes reached before and after a character, and the step each
+  // node was last added to one in, reused by every check. A PathRules is
+  // only matched from one thread at a time.
+  mutable std::vector<std::uint32_t> current_nodes;
+  mutable std::vector<std::uint32_t> next_nodes;
+  mutable std::vector<std::uint32_t> added_steps;
+  mutable std::uint32_t step = 0;
+
+  const Node *findChild(const Node &node, char label) const;
+
+  // Adds a node, and the nodes it reaches through '*' without consuming a
+  // character, to `node_set` unless they are in it already.
+  void addNode(std::uint32_t node, std::vector<std::uint32_t> &node_set) const;
+
+  // Starts a new set of nodes.
+  void nextStep() const;
+};
+
 // A structure to hold the rules for a group of user-agents.
 struct RuleGroup {
-  std::vector<std::string> allow_patterns;
-  std::vector<std::string> disallow_patterns;
+  PathRules path_rules;
   std::optional<int> crawl_delay;
 };
 
@@ -21,22 +88,29 @@ public:
   // missing).
   RobotsParser();
 
-  // Constructor that parses content from a robots.txt file.
-  explicit RobotsParser(const std::string &content);
+  // Constructor that parses content from a robots.txt file and resolves the
+  // group that applies to `user_agent` once, up front. Matching of the
+  // user-agent is case-insensitive and ignores version numbers.
+  RobotsParser(const std::string &content, const std::string &user_agent);
 
-  // Checks if a given path is allowed for a specific user-agent.
-  // This method is case-insensitive for the user-agent and ignores version
-  // numbers.
-  bool IsAllowed(const std::string &path, const std::string &user_agent) const;
+  // agent_rules points into rules, so copies would dangle.
+  RobotsParser(const RobotsParser &) = delete;
+  RobotsParser &operator=(const RobotsParser &) = delete;
 
-  // Gets the crawl delay specified for a user-agent, if any.
-  std::optional<int> GetCrawlDelay(const std::string &user_agent) const;
+  // Checks if a given path (including its query) is allowed.
+  bool IsAllowed(std::string_view path) const;
+
+  // Gets the crawl delay specified for the user-agent, if any.
+  std::optional<int> GetCrawlDelay() const;
 
 private:
   // Internal storage mapping a normalized user-agent string to its specific
   // rules.
   std::map<std::string, RuleGroup> rules;
 
+  // Group that applies to the crawler's user-agent, or nullptr if none does.
+  const RuleGroup *agent_rules = nullptr;
+
   // Helper to find the most relevant RuleGroup for a given user-agent.
   const RuleGroup *findRulesForAgent(const std::string &user_agent) const;
 
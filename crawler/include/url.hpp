@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <ada.h>
+#include <ada/implementation.h> // IWYU pragma: keep
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace crawler {
+
+// Small integer standing in for a host name (including its port).
+using HostId = std::uint32_t;
+
+// Interns host names so the frontier can key its per-host state on a HostId
+// instead of hashing and copying host strings.
+class HostTable {
+public:
+  HostId Intern(std::string_view host);
+
+  const std::string &GetHost(HostId host_id) const;
+
+private:
+  // Lets host_ids be searched with a std::string_view.
+  struct HostHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view host) const {
+      return std::hash<std::string_view>{}(host);
+    }
+  };
+
+  std::vector<std::string> hosts;
+  std::unordered_map<std::string, HostId, HostHash, std::equal_to<>> host_ids;
+};
+
+// A URL parsed and normalized once, when it is discovered, and carried
+// through the frontier as is.
+struct NormalizedUrl {
+  // Serialized URL without its fragment.
+  std::string href;
+  HostId host_id = 0;
+  // Position of the path and query in href.
+  std::uint32_t path_offset = 0;
+
+  // Path and query, e.g. "/docs/index.html?lang=en".
+  std::string_view GetPath() const;
+
+  // Scheme and authority, e.g. "https://example.com:8080".
+  std::string_view GetOrigin() const;
+};
+
+// Parses `link`, resolving it against `base_url` when it is relative. Returns
+// std::nullopt for invalid URLs and for anything but http(s) URLs.
+std::optional<NormalizedUrl> ParseUrl(std::string_view link,
+                                      const ada::url_aggregator *base_url,
+                                      HostTable &host_table);
+
+} // namespace crawler
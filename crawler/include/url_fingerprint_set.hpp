@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace crawler {
+
+// Set of known URLs that stores a 64-bit fingerprint per URL instead of the
+// URL itself. Fingerprints live in an open-addressing table that doubles as
+// it fills, up to a fixed memory limit, which growing the table stays
+// within as well.
+//
+// Two URLs with the same fingerprint are treated as one, so a new URL is
+// reported as known with probability GetFalsePositiveRate(). Once the table
+// is at its memory limit and full, new URLs are rejected (and counted) rather
+// than growing memory further.
+class UrlFingerprintSet {
+public:
+  explicit UrlFingerprintSet(std::size_t memory_limit_bytes);
+
+  // Adds a URL. Returns true if the URL was not known before and has been
+  // recorded, false if it was already known or the set is full.
+  bool Insert(std::string_view url);
+
+  // Adds the fingerprint of a URL, as returned by Fingerprint(), such as one
+  // persisted by an earlier run.
+  bool InsertFingerprint(std::uint64_t fingerprint);
+
+  bool Contains(std::string_view url) const;
+
+  std::size_t Size() const;
+
+  std::size_t GetMemoryUsage() const;
+
+  // Number of URLs rejected because the set was full.
+  std::size_t GetRejectedCount() const;
+
+  // Probability that a URL never inserted is reported as known, given the
+  // number of fingerprints currently stored.
+  double GetFalsePositiveRate() const;
+
+  static std::uint64_t Fingerprint(std::string_view url);
+
+private:
+  // Slot value marking an empty slot. Fingerprints equal to it are remapped.
+  static constexpr std::uint64_t kEmptySlot = 0;
+
+  std::vector<std::uint64_t> slots;
+  std::size_t size;
+  std::size_t max_slot_count;
+  std::size_t rejected_count;
+
+  std::size_t findSlot(std::uint64_t fingerprint) const;
+
+  bool isAtLoadLimit() const;
+
+  void grow();
+};
+
+} // namespace crawler
@@ -1,9 +1,10 @@
 // SPDX-License-Identifier: AGPL-3.0-only
 #pragma once
 
-#include <ada.h>
-#include <ada/implementation.h> // IWYU pragma: keep
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace utils {
 
@@ -14,12 +15,18 @@ std::string NormalizeKey(const std::string &s);
 // Trims whitespace from the beginning of a rule's value.
 std::string TrimValue(const std::string &s);
 
-// Extracts the host from a URL string.
-std::string GetHostFromUrl(const std::string &url_string);
+// Trims ASCII whitespace from both ends of a string.
+std::string_view TrimWhitespace(std::string_view s);
 
-// Extracts the base URL from a URL string
-std::string GetBaseUrl(const std::string &url_string);
+// Decodes the character references (&amp;, &#39;, ...) in HTML text or in an
+// attribute value. Unknown named references are kept as written.
+std::string DecodeHtmlEntities(std::string_view text);
+
+// Escapes '&' and '<' in text, so that it reads back unchanged when parsed
+// as HTML.
+std::string EscapeHtmlText(std::string_view text);
+
+// 128-bit MurmurHash3 (x64 variant) of a string.
+std::pair<std::uint64_t, std::uint64_t> Hash128(std::string_view data);
 
-// Extracts the path from a URL string.
-std::string GetPathFromUrl(const std::string &url_string);
 } // namespace utils
\ No newline at end of file
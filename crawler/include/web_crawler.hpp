@@ -1,25 +1,101 @@
 // SPDX-License-Identifier: AGPL-3.0-only
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <optional>
-#include <regex>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "html_extractor.hpp"
+#include "options.hpp"
+#include "url.hpp"
+
+struct curl_slist;
+
 namespace crawler {
 
 typedef void CURL;
+typedef void CURLM;
+typedef void CURLSH;
 
 // Custom deleter for CURL to ensure proper cleanup
 struct CURLDeleter {
   void operator()(CURL *curl) const;
 };
 
+// Custom deleter for the CURL multi handle
+struct CURLMDeleter {
+  void operator()(CURLM *multi) const;
+};
+
+// Custom deleter for the CURL share handle
+struct CURLSHDeleter {
+  void operator()(CURLSH *share) const;
+};
+
+// Custom deleter for a list of request headers
+struct CURLSlistDeleter {
+  void operator()(curl_slist *list) const;
+};
+
+// RFC 9309 only requires parsing the first 500 KiB of a robots.txt. A
+// longer one is cut there rather than rejected.
+constexpr std::size_t kMaxRobotsTxtSize = 500 * 1024;
+
+// The validators of a response, sent back with the next request for the
+// same page so the server can answer 304 Not Modified instead of resending
+// an unchanged body.
+struct HttpValidators {
+  std::optional<std::string> etag;
+  std::optional<std::string> last_modified;
+
+  bool IsEmpty() const {
+    return !etag.has_value() && !last_modified.has_value();
+  }
+};
+
+// A fetched page. The body is owned once, by `content`; the title, base URL
+// and links are spans of it, so moving a PageResult never copies the page.
 struct PageResult {
   std::optional<std::string> content;
-  std::optional<std::string> title;
-  std::vector<std::string> links;
+  std::optional<TextSpan> title;
+  // Value of the page's <base href>, if any. Relative links resolve against
+  // it instead of the page URL.
+  std::optional<TextSpan> base_url;
+  std::vector<TextSpan> links;
+  // Target of a 301/302 response.
+  std::optional<std::string> redirect_url;
+  ContentSignature content_signature;
+
+  // Raw, undecoded markup covered by a span of the content.
+  std::string_view GetText(const TextSpan &span) const;
+};
+
+enum class FetchKind {
+  Page,
+  RobotsTxt,
+};
+
+struct FetchRequest {
+  NormalizedUrl url;
+  FetchKind kind;
+  // Makes the request conditional when set.
+  HttpValidators validators;
+};
+
+// A finished background fetch, as handed back by PopCompletedPage().
+struct FetchResult {
+  NormalizedUrl url;
+  FetchKind kind;
+  // HTTP status of the response, or 0 if the transfer itself failed.
+  long http_code;
+  std::optional<PageResult> page;
+  // Validators of a 200 or 304 response.
+  HttpValidators validators;
 };
 
 class WebCrawler {
@@ -27,16 +103,99 @@ public:
   // Constructor
   WebCrawler();
 
+  // Constructor for a crawler that keeps up to `max_concurrent_requests`
+  // background fetches in flight, with the download limits and timeouts of
+  // `crawl_options`.
+  explicit WebCrawler(const CrawlOptions &crawl_options);
+
   // Destructor
   ~WebCrawler();
 
-  std::optional<PageResult> GetPage(const std::string &url);
+  // Starts fetching the requested URL in the background. Returns false if
+  // every transfer slot is already busy or the transfer cannot be started;
+  // the fetch is then handed back by PopCompletedPage() as a failed one, so
+  // its host is released like after a network error.
+  bool SubmitPage(FetchRequest request);
+
+  bool HasFreeSlot() const;
+
+  // True while there are fetches in flight or completed fetches that have not
+  // been popped yet.
+  bool HasPendingPages() const;
+
+  // Drives the in-flight fetches, waiting at most `timeout` for network
+  // activity. Finished fetches are moved to the completed queue.
+  void Perform(std::chrono::milliseconds timeout);
+
+  std::optional<FetchResult> PopCompletedPage();
+
+  // True if a fetch from the host finished recently enough for its
+  // connection to likely still be open for reuse.
+  bool HasWarmConnection(HostId host_id) const;
 
 private:
-  std::unique_ptr<CURL, CURLDeleter> curl;
+  // A reusable easy handle together with the state of the fetch it is
+  // currently running. The body is run through the extractor as it arrives,
+  // once its headers have been accepted.
+  struct Transfer {
+    std::unique_ptr<CURL, CURLDeleter> handle;
+    NormalizedUrl url;
+    FetchKind kind = FetchKind::Page;
+    std::string read_buffer;
+    HtmlExtractor extractor;
+    std::size_t max_body_size = 0;
+    bool is_response_checked = false;
+    // Set for responses other than 200, whose bodies are not downloaded.
+    bool is_body_discarded = false;
+    std::size_t discarded_size = 0;
+    // Set when a robots.txt is cut at kMaxRobotsTxtSize, or a discarded body
+    // grows too long, which ends the transfer early but successfully.
+    bool is_truncated = false;
+    // Why the response was rejected, which aborts the transfer.
+    std::optional<std::string> rejection;
+    // Conditional request headers, kept alive while the fetch runs.
+    std::unique_ptr<curl_slist, CURLSlistDeleter> headers;
+    bool busy = false;
+  };
+
+  // Every transfer shares resolved host names and TLS sessions through the
+  // share handle, and connections through the multi handle.
+  std::unique_ptr<CURLSH, CURLSHDeleter> share;
+  std::unique_ptr<CURLM, CURLMDeleter> multi;
+  std::vector<std::unique_ptr<Transfer>> transfers;
+  std::queue<FetchResult> completed_pages;
+  int running_transfers = 0;
   bool is_curl_global_init;
-  std::regex link_regex;
-  std::regex title_regex;
+  long connect_timeout;
+  long request_timeout;
+  long low_speed_limit;
+  long low_speed_time;
+  long dns_cache_timeout;
+  std::chrono::seconds connection_max_idle;
+  std::size_t max_cached_connections;
+  // When the last fetch from every host recently fetched from finished
+  std::unordered_map<HostId, std::chrono::steady_clock::time_point>
+      idle_hosts;
+
+  void setTransferOptions(CURL *handle, Transfer *transfer) const;
+
+  void setConditionalHeaders(Transfer &transfer,
+                             const HttpValidators &validators) const;
+
+  static HttpValidators getValidators(CURL *handle);
+
+  // Records that a fetch from the host finished, leaving its connection
+  // idle, and forgets hosts whose connections have expired.
+  void markHostAsIdle(HostId host_id);
+
+  std::optional<PageResult> buildPageResult(CURL *handle, Transfer &transfer);
+
+  // Checks the headers of a 200 response to a page before its body is
+  // downloaded: pages are only downloaded as HTML, and not past the body
+  // size limit. Returns why the page is rejected, if it is.
+  static std::optional<std::string> checkResponse(const Transfer &transfer);
+
+  static bool isHtmlContentType(std::string_view content_type);
 
   static std::size_t writeCallback(void *contents, std::size_t size,
                                    std::size_t nmemb, void *userp);
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "content_signature.hpp"
+
+#include "utils.hpp"
+
+namespace crawler {
+
+namespace {
+
+// ASCII letters and digits, and every byte of a multi-byte UTF-8 character.
+// Punctuation and the delimiters of character references separate words.
+bool isWordByte(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+char toLowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+} // namespace
+
+ContentSignatureBuilder::ContentSignatureBuilder() { Reset(); }
+
+void ContentSignatureBuilder::Feed(std::string_view text) {
+  for (char c : text) {
+    if (!isWordByte(static_cast<unsigned char>(c))) {
+      endWord();
+      continue;
+    }
+    if (!is_in_word) {
+      if (!normalized_text.empty()) {
+        normalized_text.push_back(' ');
+      }
+      word_offset = normalized_text.size();
+      is_in_word = true;
+    }
+    normalized_text.push_back(toLowerAscii(c));
+  }
+}
+
+void ContentSignatureBuilder::BreakWord() { endWord(); }
+
+ContentSignature ContentSignatureBuilder::Finish() {
+  endWord();
+  ContentSignature signature{.text_hash = utils::Hash128(normalized_text),
+                             .simhash = 0,
+                             .word_count = word_count};
+  for (std::size_t bit = 0; bit < bit_weights.size(); ++bit) {
+    if (bit_weights[bit] > 0) {
+      signature.simhash |= std::uint64_t{1} << bit;
+    }
+  }
+  return signature;
+}
+
+void ContentSignatureBuilder::Reset() {
+  normalized_text.clear();
+  is_in_word = false;
+  word_offset = 0;
+  word_count = 0;
+  bit_weights.fill(0);
+}
+
+// Private methods
+
+void ContentSignatureBuilder::endWord() {
+  if (!is_in_word) {
+    return;
+  }
+  is_in_word = false;
+  ++word_count;
+
+  std::uint64_t hash =
+      utils::Hash128(std::string_view(normalized_text).substr(word_offset))
+          .first;
+  for (std::size_t bit = 0; bit < bit_weights.size(); ++bit) {
+    bit_weights[bit] += ((hash >> bit) & 1) ? 1 : -1;
+  }
+}
+
+} // namespace crawler
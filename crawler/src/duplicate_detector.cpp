@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "duplicate_detector.hpp"
+
+#include <bit>
+#include <iostream>
+
+#include "url_fingerprint_set.hpp"
+
+namespace crawler {
+
+namespace {
+
+// The SimHash of a shorter text moves too much with a single word for a
+// few bits of difference to mean much; such pages only match exactly.
+constexpr std::uint32_t kMinNearDuplicateWords = 32;
+
+} // namespace
+
+DuplicateDetector::DuplicateDetector(
+    std::vector<IndexedPageSignature> indexed_pages)
+    : pages(std::move(indexed_pages)) {
+  for (std::uint32_t page_id = 0; page_id < pages.size(); ++page_id) {
+    page_ids.emplace(pages[page_id].fingerprint, page_id);
+    addPage(page_id, std::nullopt);
+  }
+
+  if (!pages.empty()) {
+    std::cout << "Loaded the signatures of " << pages.size()
+              << " indexed pages" << std::endl;
+  }
+}
+
+std::optional<std::uint64_t>
+DuplicateDetector::FindCanonicalPage(std::string_view url,
+                                     const ContentSignature &signature) {
+  std::uint64_t fingerprint = UrlFingerprintSet::Fingerprint(url);
+  if (auto it = page_ids.find(fingerprint); it != page_ids.end()) {
+    // Pages are only replaced by aliases before they are indexed
+    IndexedPageSignature &page = pages[it->second];
+    ContentSignature previous_signature = page.signature;
+    if (auto hash_it = text_hashes.find(previous_signature.text_hash);
+        hash_it != text_hashes.end() && hash_it->second == it->second) {
+      text_hashes.erase(hash_it);
+    }
+    page.signature = signature;
+    addPage(it->second, previous_signature);
+    return std::nullopt;
+  }
+
+  if (std::optional<std::uint32_t> page_id = findDuplicate(signature)) {
+    return pages[*page_id].fingerprint;
+  }
+
+  auto page_id = static_cast<std::uint32_t>(pages.size());
+  pages.push_back({.fingerprint = fingerprint, .signature = signature});
+  page_ids.emplace(fingerprint, page_id);
+  addPage(page_id, std::nullopt);
+  return std::nullopt;
+}
+
+// Private methods
+
+std::optional<std::uint32_t>
+DuplicateDetector::findDuplicate(const ContentSignature &signature) {
+  // Pages without any text are not duplicates of each other
+  if (signature.word_count == 0) {
+    return std::nullopt;
+  }
+  if (auto it = text_hashes.find(signature.text_hash);
+      it != text_hashes.end()) {
+    return it->second;
+  }
+  if (signature.word_count < kMinNearDuplicateWords) {
+    return std::nullopt;
+  }
+
+  for (int band = 0; band < kBandCount; ++band) {
+    auto it = bands[band].find(getBand(signature.simhash, band));
+    if (it == bands[band].end()) {
+      continue;
+    }
+    for (std::uint32_t page_id : it->second) {
+      const ContentSignature &candidate = pages[page_id].signature;
+      if (candidate.word_count >= kMinNearDuplicateWords &&
+          std::popcount(candidate.simhash ^ signature.simhash) <=
+              kMaxDistance) {
+        return page_id;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+void DuplicateDetector::addPage(
+    std::uint32_t page_id,
+    const std::optional<ContentSignature> &previous_signature) {
+  const ContentSignature &signature = pages[page_id].signature;
+  // The first page indexed with a text stays its canonical page
+  if (signature.word_count > 0) {
+    text_hashes.try_emplace(signature.text_hash, page_id);
+  }
+
+  bool was_banded = previous_signature.has_value() &&
+                    previous_signature->word_count >= kMinNearDuplicateWords;
+  bool is_banded = signature.word_count >= kMinNearDuplicateWords;
+  for (int band = 0; band < kBandCount; ++band) {
+    std::uint16_t value = getBand(signature.simhash, band);
+    if (was_banded) {
+      std::uint16_t previous_value =
+          getBand(previous_signature->simhash, band);
+      if (is_banded && previous_value == value) {
+        continue;
+      }
+      // The page moves out of the bucket of its previous value
+      auto it = bands[band].find(previous_value);
+      std::erase(it->second, page_id);
+      if (it->second.empty()) {
+        bands[band].erase(it);
+      }
+    }
+    if (is_banded) {
+      bands[band][value].push_back(page_id);
+    }
+  }
+}
+
+std::uint16_t DuplicateDetector::getBand(std::uint64_t simhash, int band) {
+  return static_cast<std::uint16_t>(simhash >> (band * kBandBits));
+}
+
+} // namespace crawler
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "html_extractor.hpp"
+
+#include <cctype>
+#include <cstring>
+
+namespace crawler {
+
+namespace {
+
+// Limits that keep a hostile page from growing the tokenizer buffers.
+constexpr std::size_t kMaxTagNameLength = 16;
+constexpr std::size_t kMaxAttributeNameLength = 16;
+constexpr std::size_t kMaxAttributeValueLength = 8192;
+constexpr std::size_t kMaxRelLength = 64;
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool isAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+char toLower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+} // namespace
+
+HtmlExtractor::HtmlExtractor() { Reset(); }
+
+void HtmlExtractor::Reset() {
+  state = State::Text;
+  chunk_offset = 0;
+  chunk_begin = nullptr;
+  is_end_tag = false;
+  quote_char = '"';
+  dash_count = 0;
+  raw_text_match = 0;
+  raw_text_match_offset = 0;
+  tag_name.clear();
+  attribute_name.clear();
+  attribute_value_offset = 0;
+  rel.clear();
+  href.reset();
+  raw_text_tag.clear();
+  is_in_title = false;
+  title_offset = 0;
+  title.reset();
+  base_href.reset();
+  links.clear();
+  signature_builder.Reset();
+}
+
+std::optional<TextSpan> HtmlExtractor::TakeTitle() {
+  if (is_in_title) {
+    // Unterminated title, keep what was downloaded
+    title = TextSpan{.offset = title_offset,
+                     .length = chunk_offset - title_offset};
+    is_in_title = false;
+  }
+  return title;
+}
+
+std::optional<TextSpan> HtmlExtractor::TakeBaseHref() { return base_href; }
+
+std::vector<TextSpan> HtmlExtractor::TakeLinks() { return std::move(links); }
+
+ContentSignature HtmlExtractor::TakeContentSignature() {
+  return signature_builder.Finish();
+}
+
+void HtmlExtractor::Feed(std::string_view chunk) {
+  const char *it = chunk.data();
+  const char *end = it + chunk.size();
+  chunk_begin = it;
+
+  // Every state either consumes at least one character or switches to a
+  // state that will, so the loop always makes progress.
+  while (it < end) {
+    char c = *it;
+    switch (state) {
+    case State::Text: {
+      const char *tag_start =
+          static_cast<const char *>(std::memchr(it, '<', end - it));
+      if (!tag_start) {
+        signature_builder.Feed(std::string_view(it, end - it));
+        it = end;
+        break;
+      }
+      signature_builder.Feed(std::string_view(it, tag_start - it));
+      signature_builder.BreakWord();
+      it = tag_start + 1;
+      state = State::TagOpen;
+      break;
+    }
+    case State::TagOpen:
+      if (c == '!') {
+        dash_count = 0;
+        state = State::MarkupDeclaration;
+        ++it;
+      } else if (c == '/') {
+        state = State::EndTagOpen;
+        ++it;
+      } else if (isAlpha(c)) {
+        is_end_tag = false;
+        tag_name.clear();
+        state = State::TagName;
+      } else if (c == '?') {
+        state = State::BogusComment;
+        ++it;
+      } else {
+        state = State::Text; // A lone '<' is plain text
+      }
+      break;
+    case State::EndTagOpen:
+      if (isAlpha(c)) {
+        is_end_tag = true;
+        tag_name.clear();
+        state = State::TagName;
+      } else if (c == '>') {
+        state = State::Text;
+        ++it;
+      } else {
+        state = State::BogusComment;
+      }
+      break;
+    case State::TagName:
+      if (isSpace(c)) {
+        state = State::BeforeAttributeName;
+      } else if (c == '/') {
+        state = State::SelfClosingTag;
+      } else if (c == '>') {
+        finishTag(it);
+      } else {
+        appendLower(tag_name, c, kMaxTagNameLength);
+      }
+      ++it;
+      break;
+    case State::BeforeAttributeName:
+      if (isSpace(c)) {
+        ++it;
+      } else if (c == '/') {
+        state = State::SelfClosingTag;
+        ++it;
+      } else if (c == '>') {
+        finishTag(it);
+        ++it;
+      } else {
+        attribute_name.clear();
+        appendLower(attribute_name, c, kMaxAttributeNameLength);
+        state = State::AttributeName;
+        ++it;
+      }
+      break;
+    case State::AttributeName:
+      if (isSpace(c)) {
+        state = State::AfterAttributeName;
+      } else if (c == '/') {
+        finishAttribute(nullptr);
+        state = State::SelfClosingTag;
+      } else if (c == '=') {
+        state = State::BeforeAttributeValue;
+      } else if (c == '>') {
+        finishAttribute(nullptr);
+        finishTag(it);
+      } else {
+        appendLower(attribute_name, c, kMaxAttributeNameLength);
+      }
+      ++it;
+      break;
+    case State::AfterAttributeName:
+      if (isSpace(c)) {
+        ++it;
+      } else if (c == '=') {
+        state = State::BeforeAttributeValue;
+        ++it;
+      } else {
+        // An attribute without a value; the next one starts here.
+        finishAttribute(nullptr);
+        state = State::BeforeAttributeName;
+      }
+      break;
+    case State::BeforeAttributeValue:
+      if (isSpace(c)) {
+        ++it;
+      } else if (c == '"' || c == '\'') {
+        quote_char = c;
+        state = State::AttributeValueQuoted;
+        ++it;
+        attribute_value_offset = offsetOf(it);
+      } else if (c == '>') {
+        finishAttribute(nullptr);
+        finishTag(it);
+        ++it;
+      } else {
+        state = State::AttributeValueUnquoted;
+        attribute_value_offset = offsetOf(it);
+      }
+      break;
+    case State::AttributeValueQuoted: {
+      const char *value_end =
+          static_cast<const char *>(std::memchr(it, quote_char, end - it));
+      const char *stop = value_end ? value_end : end;
+      if (attribute_name == "rel") {
+        for (; it < stop; ++it) {
+          appendLower(rel, *it, kMaxRelLength);
+        }
+      }
+      it = stop;
+      if (value_end) {
+        finishAttribute(value_end);
+        state = State::BeforeAttributeName;
+        ++it;
+      }
+      break;
+    }
+    case State::AttributeValueUnquoted:
+      if (isSpace(c)) {
+        finishAttribute(it);
+        state = State::BeforeAttributeName;
+      } else if (c == '>') {
+        finishAttribute(it);
+        finishTag(it);
+      } else if (attribute_name == "rel") {
+        appendLower(rel, c, kMaxRelLength);
+      }
+      ++it;
+      break;
+    case State::SelfClosingTag:
+      if (c == '>') {
+        finishTag(it);
+        ++it;
+      } else {
+        state = State::BeforeAttributeName;
+      }
+      break;
+    case State::MarkupDeclaration:
+      if (c == '-' && dash_count < 2) {
+        ++dash_count;
+        ++it;
+      } else if (dash_count == 2) {
+        dash_count = 0;
+        state = State::Comment;
+      } else {
+        state = State::BogusComment; // <!DOCTYPE ...> and friends
+      }
+      break;
+    case State::Comment:
+      if (c == '>' && dash_count >= 2) {
+        state = State::Text;
+      } else if (c == '-') {
+        ++dash_count;
+      } else {
+        dash_count = 0;
+      }
+      ++it;
+      break;
+    case State::BogusComment: {
+      const char *comment_end =
+          static_cast<const char *>(std::memchr(it, '>', end - it));
+      if (!comment_end) {
+        it = end;
+        break;
+      }
+      it = comment_end + 1;
+      state = State::Text;
+      break;
+    }
+    case State::RawText:
+      feedRawText(it, end);
+      break;
+    }
+  }
+
+  chunk_offset += chunk.size();
+}
+
+// Private methods
+
+std::size_t HtmlExtractor::offsetOf(const char *it) const {
+  return chunk_offset + static_cast<std::size_t>(it - chunk_begin);
+}
+
+void HtmlExtractor::feedRawText(const char *&it, const char *end) {
+  // Raw text ends at "</" followed by the element name and a delimiter. The
+  // match can span chunks, so only the number of matched characters is kept.
+  const std::size_t end_tag_length = raw_text_tag.size() + 2;
+
+  while (it < end) {
+    if (raw_text_match == 0) {
+      const char *tag_start =
+          static_cast<const char *>(std::memchr(it, '<', end - it));
+      if (!tag_start) {
+        it = end;
+        return;
+      }
+      raw_text_match = 1;
+      raw_text_match_offset = offsetOf(tag_start);
+      it = tag_start + 1;
+      continue;
+    }
+
+    char c = *it;
+    if (raw_text_match < end_tag_length) {
+      char expected =
+          raw_text_match == 1 ? '/' : raw_text_tag[raw_text_match - 2];
+      if (toLower(c) == expected) {
+        ++raw_text_match;
+        ++it;
+        continue;
+      }
+    } else if (isSpace(c) || c == '/' || c == '>') {
+      if (is_in_title) {
+        title = TextSpan{.offset = title_offset,
+                         .length = raw_text_match_offset - title_offset};
+        is_in_title = false;
+      }
+      is_end_tag = true;
+      tag_name = std::move(raw_text_tag);
+      raw_text_tag.clear();
+      raw_text_match = 0;
+      state = State::BeforeAttributeName;
+      return;
+    }
+
+    // Not the end tag after all, keep scanning the content.
+    raw_text_match = 0;
+  }
+}
+
+void HtmlExtractor::finishAttribute(const char *value_end) {
+  if (is_end_tag || (tag_name != "a" && tag_name != "base")) {
+    return;
+  }
+
+  if (attribute_name == "href" && !href.has_value()) {
+    std::size_t length =
+        value_end ? offsetOf(value_end) - attribute_value_offset : 0;
+    if (length <= kMaxAttributeValueLength) {
+      href = TextSpan{.offset = attribute_value_offset, .length = length};
+    }
+  }
+}
+
+void HtmlExtractor::finishTag(const char *it) {
+  state = State::Text;
+
+  if (!is_end_tag) {
+    if (tag_name == "a") {
+      if (href.has_value() && href->length > 0 &&
+          rel.find("nofollow") == std::string::npos) {
+        links.push_back(*href);
+      }
+    } else if (tag_name == "base") {
+      if (href.has_value() && !base_href.has_value()) {
+        base_href = href;
+      }
+    } else if (tag_name == "title") {
+      if (!title.has_value()) {
+        is_in_title = true;
+        title_offset = offsetOf(it) + 1;
+      }
+      raw_text_tag = tag_name;
+      state = State::RawText;
+    } else if (tag_name == "script" || tag_name == "style" ||
+               tag_name == "textarea") {
+      raw_text_tag = tag_name;
+      state = State::RawText;
+    }
+  }
+
+  href.reset();
+  rel.clear();
+  raw_text_match = 0;
+}
+
+void HtmlExtractor::appendLower(std::string &target, char c,
+                                std::size_t limit) {
+  if (target.size() < limit) {
+    target.push_back(toLower(c));
+  }
+}
+
+} // namespace crawler
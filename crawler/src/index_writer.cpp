@@ -2,9 +2,23 @@
 
 #include "config.hpp"
 #include "index_writer.hpp"
+#include "tokenizer.hpp"
+#include "url_fingerprint_set.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 
 namespace crawler {
+
+namespace {
+
+// How long the writer thread sleeps while there is nothing to write
+constexpr auto kIdleWaitTime = std::chrono::seconds(1);
+
+} // namespace
+
 void SQLiteDbDeleter::operator()(sqlite3 *db) const {
   if (db) {
     sqlite3_close(db);
@@ -18,7 +32,14 @@ void SQLiteStmtDeleter::operator()(sqlite3_stmt *stmt) const {
 }
 
 IndexWriter::IndexWriter(
-    std::unique_ptr<crawler::DatabaseOptions> db_options) {
+    std::unique_ptr<crawler::DatabaseOptions> db_options)
+    : body_compressor(db_options->compression_level),
+      dictionary_sample_pages(static_cast<std::size_t>(
+          std::max(db_options->dictionary_sample_pages, 0))),
+      batch_size(std::max(db_options->batch_size, 1)),
+      batch_interval(db_options->batch_interval_ms),
+      write_queue(static_cast<std::size_t>(
+          std::max(db_options->queue_capacity, 1))) {
   // Open the SQLite database
   sqlite3 *raw_db_handle = nullptr;
   if (sqlite3_open(db_options->db_path.c_str(), &raw_db_handle) != SQLITE_OK) {
@@ -43,48 +64,667 @@ IndexWriter::IndexWriter(
     throw std::runtime_error("Failed to load FTS HTML extension: " + error_msg);
   }
 
-  const char *sql = "INSERT INTO webpages(url, title, content) VALUES "
-                    "(?, ?, ?) ON CONFLICT(url) DO UPDATE SET "
-                    "title=excluded.title, content=excluded.content;";
-  sqlite3_stmt *raw_stmt = nullptr;
-  if (sqlite3_prepare_v2(db.get(), sql, -1, &raw_stmt, nullptr) != SQLITE_OK) {
-    std::string error_msg = sqlite3_errmsg(db.get());
-    sqlite3_close(db.get());
-    throw std::runtime_error("Failed to prepare SQLite statement: " +
-                             error_msg);
+  applyPragmas(*db_options);
+  createGenerationTable();
+  createFrontierTables();
+  createDuplicateTables();
+  createBodyTables();
+  restored_frontier = loadFrontier();
+  restored_signatures = loadSignatures();
+  loadDictionary();
+
+  insert_stmt = prepareStatement(
+      "INSERT INTO webpages(url, title, content) VALUES "
+      "(?, ?, ?) ON CONFLICT(url) DO UPDATE SET "
+      "title=excluded.title, content=excluded.content;");
+  begin_stmt = prepareStatement("BEGIN;");
+  commit_stmt = prepareStatement("COMMIT;");
+  bump_generation_stmt = prepareStatement(
+      "UPDATE index_generation SET generation = generation + 1 WHERE id = 0;");
+  insert_known_link_stmt =
+      prepareStatement("INSERT OR IGNORE INTO crawl_known_links VALUES (?);");
+  queue_link_stmt = prepareStatement(
+      "INSERT OR IGNORE INTO crawl_queue(fingerprint, url) VALUES (?, ?);");
+  dequeue_link_stmt =
+      prepareStatement("DELETE FROM crawl_queue WHERE fingerprint = ?;");
+  upsert_robots_txt_stmt = prepareStatement(
+      "INSERT INTO crawl_robots_txt(host, content, fetched_at) VALUES "
+      "(?, ?, ?) ON CONFLICT(host) DO UPDATE SET "
+      "content=excluded.content, fetched_at=excluded.fetched_at;");
+  upsert_fetched_page_stmt = prepareStatement(
+      "INSERT OR REPLACE INTO crawl_pages(fingerprint, url, etag, "
+      "last_modified, content_hash, fetched_at, next_fetch_at, change_count, "
+      "observed_seconds) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);");
+  upsert_signature_stmt = prepareStatement(
+      "INSERT OR REPLACE INTO crawl_signatures(fingerprint, url, "
+      "text_hash_high, text_hash_low, simhash, word_count) VALUES "
+      "(?, ?, ?, ?, ?, ?);");
+  upsert_alias_stmt = prepareStatement(
+      "INSERT OR REPLACE INTO crawl_aliases(url, canonical_url) SELECT ?, "
+      "url FROM crawl_signatures WHERE fingerprint = ?;");
+  delete_alias_stmt =
+      prepareStatement("DELETE FROM crawl_aliases WHERE url = ?;");
+  upsert_body_stmt = prepareStatement(
+      "INSERT OR REPLACE INTO webpage_bodies(url, dictionary_id, size, body) "
+      "VALUES (?, ?, ?, ?);");
+  insert_dictionary_stmt =
+      prepareStatement("INSERT INTO body_dictionaries(dictionary) VALUES (?);");
+
+  writer_thread = std::thread(&IndexWriter::writerLoop, this);
+}
+
+IndexWriter::~IndexWriter() {
+  write_queue.Close();
+  writer_thread.join();
+}
+
+FrontierSnapshot IndexWriter::TakeRestoredFrontier() {
+  return std::exchange(restored_frontier, FrontierSnapshot{});
+}
+
+std::vector<IndexedPageSignature> IndexWriter::TakeRestoredSignatures() {
+  return std::exchange(restored_signatures, {});
+}
+
+bool IndexWriter::EnqueuePage(std::string url, PageResult page_result,
+                              FrontierUpdate frontier_update) {
+  return write_queue.Push(
+      WriteRequest{.url = std::move(url),
+                   .page_result = std::move(page_result),
+                   .frontier_update = std::move(frontier_update),
+                   .drained = nullptr});
+}
+
+bool IndexWriter::EnqueueDuplicate(std::string url,
+                                   std::uint64_t canonical_fingerprint,
+                                   FrontierUpdate frontier_update) {
+  return write_queue.Push(
+      WriteRequest{.url = std::move(url),
+                   .canonical_fingerprint = canonical_fingerprint,
+                   .frontier_update = std::move(frontier_update)});
+}
+
+bool IndexWriter::EnqueueFrontierUpdate(FrontierUpdate frontier_update) {
+  if (frontier_update.IsEmpty()) {
+    return true;
   }
+  return write_queue.Push(
+      WriteRequest{.frontier_update = std::move(frontier_update)});
+}
+
+bool IndexWriter::IsBacklogged() const { return write_queue.IsFull(); }
 
-  insert_stmt.reset(raw_stmt);
+bool IndexWriter::Drain() {
+  auto drained = std::make_shared<std::promise<bool>>();
+  std::future<bool> is_flushed = drained->get_future();
+  if (!write_queue.Push(WriteRequest{.drained = drained})) {
+    return false;
+  }
+  return is_flushed.get();
 }
 
-IndexWriter::~IndexWriter() = default;
+// Private methods
+
+void IndexWriter::writerLoop() {
+  while (true) {
+    // Wake up in time to commit a batch that has been open for too long
+    auto deadline = is_in_transaction
+                        ? batch_start_time + batch_interval
+                        : std::chrono::steady_clock::now() + kIdleWaitTime;
+    std::optional<WriteRequest> request = write_queue.PopUntil(deadline);
+    if (!request.has_value()) {
+      if (write_queue.IsClosed()) {
+        break;
+      }
+      flushIfDue();
+      continue;
+    }
+
+    if (request->drained) {
+      request->drained->set_value(flush());
+      continue;
+    }
+
+    write(std::move(*request));
+  }
+
+  flush();
+}
+
+bool IndexWriter::write(WriteRequest request) {
+  if (!is_in_transaction && !beginBatch()) {
+    return false;
+  }
+
+  bool is_written = true;
+  if (request.page_result.has_value() ||
+      request.canonical_fingerprint.has_value()) {
+    has_index_changes = true;
+  }
+  if (request.page_result.has_value() &&
+      !insertPage(request.url, std::move(*request.page_result))) {
+    std::cerr << "Failed to insert page into index: " << request.url
+              << std::endl;
+    is_written = false;
+  }
+  if (request.canonical_fingerprint.has_value() &&
+      !insertAlias(request.url, *request.canonical_fingerprint)) {
+    std::cerr << "Failed to record duplicate page: " << request.url
+              << std::endl;
+    is_written = false;
+  }
+  is_written = applyFrontierUpdate(request.frontier_update) && is_written;
+  trainDictionaryIfDue();
+
+  if (batch_page_count >= batch_size) {
+    return flush() && is_written;
+  }
+  flushIfDue();
+  return is_written;
+}
 
-bool IndexWriter::InsertPage(const std::string &url,
-                             const PageResult &page_result) {
-  sqlite3_bind_text(insert_stmt.get(), 1, url.c_str(), -1, SQLITE_TRANSIENT);
+bool IndexWriter::insertPage(const std::string &url, PageResult page_result) {
+  // Both url and page_result live until the statement is reset, so every
+  // value can be bound without SQLite taking a copy.
+  sqlite3_bind_text(insert_stmt.get(), 1, url.data(),
+                    static_cast<int>(url.size()), SQLITE_STATIC);
 
+  std::string decoded_title;
   if (page_result.title.has_value()) {
-    sqlite3_bind_text(insert_stmt.get(), 2, page_result.title->c_str(), -1,
-                      SQLITE_TRANSIENT);
+    std::string_view title =
+        utils::TrimWhitespace(page_result.GetText(*page_result.title));
+    if (title.find('&') != std::string_view::npos) {
+      decoded_title = utils::DecodeHtmlEntities(title);
+      title = decoded_title;
+    }
+    sqlite3_bind_text(insert_stmt.get(), 2, title.data(),
+                      static_cast<int>(title.size()), SQLITE_STATIC);
   } else {
     sqlite3_bind_null(insert_stmt.get(), 2);
   }
 
+  // The FTS tokenizer reads markup, so the text is escaped for it
+  std::string text;
   if (page_result.content.has_value()) {
-    sqlite3_bind_text(insert_stmt.get(), 3, page_result.content->c_str(), -1,
-                      SQLITE_TRANSIENT);
+    text = utils::EscapeHtmlText(indexer::CompactText(
+        indexer::ExtractText(*page_result.content), SIZE_MAX));
+    sqlite3_bind_text(insert_stmt.get(), 3, text.data(),
+                      static_cast<int>(text.size()), SQLITE_STATIC);
   } else {
     sqlite3_bind_null(insert_stmt.get(), 3);
   }
 
-  if (sqlite3_step(insert_stmt.get()) != SQLITE_DONE) {
+  bool is_inserted = sqlite3_step(insert_stmt.get()) == SQLITE_DONE;
+  if (!is_inserted) {
     std::cerr << "Failed to insert page into SQLite database: "
               << sqlite3_errmsg(db.get()) << std::endl;
-    sqlite3_reset(insert_stmt.get());
-    return false;
   }
 
   sqlite3_reset(insert_stmt.get());
+  sqlite3_clear_bindings(insert_stmt.get());
+  if (!is_inserted) {
+    return false;
+  }
+
+  // The page is the canonical page of its text from now on
+  const ContentSignature &signature = page_result.content_signature;
+  sqlite3_stmt *stmt = upsert_signature_stmt.get();
+  sqlite3_bind_int64(
+      stmt, 1,
+      static_cast<sqlite3_int64>(UrlFingerprintSet::Fingerprint(url)));
+  sqlite3_bind_text(stmt, 2, url.data(), static_cast<int>(url.size()),
+                    SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3,
+                     static_cast<sqlite3_int64>(signature.text_hash.first));
+  sqlite3_bind_int64(stmt, 4,
+                     static_cast<sqlite3_int64>(signature.text_hash.second));
+  sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(signature.simhash));
+  sqlite3_bind_int64(stmt, 6, signature.word_count);
+  is_inserted = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  stmt = delete_alias_stmt.get();
+  sqlite3_bind_text(stmt, 1, url.data(), static_cast<int>(url.size()),
+                    SQLITE_STATIC);
+  is_inserted = sqlite3_step(stmt) == SQLITE_DONE && is_inserted;
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  if (!is_inserted) {
+    std::cerr << "Failed to write page signature to SQLite database: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+  }
+
+  if (page_result.content.has_value()) {
+    is_inserted = insertBody(url, *page_result.content) && is_inserted;
+    if (!dictionary_id.has_value() &&
+        dictionary_samples.size() < dictionary_sample_pages) {
+      dictionary_samples.emplace_back(
+          std::string_view(*page_result.content)
+              .substr(0, indexer::kMaxDictionarySampleSize));
+    }
+  }
+  ++batch_page_count;
+  return is_inserted;
+}
+
+bool IndexWriter::insertBody(const std::string &url, std::string_view body) {
+  if (!body_compressor.Compress(body, compressed_body)) {
+    std::cerr << "Failed to compress page body: " << url << std::endl;
+    return false;
+  }
+
+  sqlite3_stmt *stmt = upsert_body_stmt.get();
+  sqlite3_bind_text(stmt, 1, url.data(), static_cast<int>(url.size()),
+                    SQLITE_STATIC);
+  if (dictionary_id.has_value()) {
+    sqlite3_bind_int64(stmt, 2, *dictionary_id);
+  } else {
+    sqlite3_bind_null(stmt, 2);
+  }
+  sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(body.size()));
+  sqlite3_bind_blob(stmt, 4, compressed_body.data(),
+                    static_cast<int>(compressed_body.size()), SQLITE_STATIC);
+  bool is_inserted = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!is_inserted) {
+    std::cerr << "Failed to insert page body into SQLite database: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return is_inserted;
+}
+
+bool IndexWriter::insertAlias(const std::string &url,
+                              std::uint64_t canonical_fingerprint) {
+  // The canonical page was written before any of its duplicates, so its URL
+  // is found even while both are in the same batch
+  sqlite3_stmt *stmt = upsert_alias_stmt.get();
+  sqlite3_bind_text(stmt, 1, url.data(), static_cast<int>(url.size()),
+                    SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2,
+                     static_cast<sqlite3_int64>(canonical_fingerprint));
+  bool is_inserted = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!is_inserted) {
+    std::cerr << "Failed to insert alias into SQLite database: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+  } else if (sqlite3_changes(db.get()) == 0) {
+    std::cerr << "Canonical page of " << url << " is not in the index"
+              << std::endl;
+    is_inserted = false;
+  }
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return is_inserted;
+}
+
+void IndexWriter::trainDictionaryIfDue() {
+  if (dictionary_id.has_value() || dictionary_sample_pages == 0 ||
+      dictionary_samples.size() < dictionary_sample_pages) {
+    return;
+  }
+
+  // Bodies referring to the dictionary must never be committed without it
+  flush();
+  std::string dictionary = indexer::TrainDictionary(dictionary_samples);
+  dictionary_samples = {};
+  if (dictionary.empty()) {
+    // The samples share nothing: bodies are compressed on their own
+    dictionary_sample_pages = 0;
+    return;
+  }
+
+  sqlite3_stmt *stmt = insert_dictionary_stmt.get();
+  sqlite3_bind_blob(stmt, 1, dictionary.data(),
+                    static_cast<int>(dictionary.size()), SQLITE_STATIC);
+  bool is_inserted = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  if (!is_inserted) {
+    // Bodies keep being compressed without a dictionary
+    std::cerr << "Failed to insert body dictionary into SQLite database: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+    dictionary_sample_pages = 0;
+    return;
+  }
+
+  dictionary_id = sqlite3_last_insert_rowid(db.get());
+  std::cout << "Trained a " << dictionary.size()
+            << " byte dictionary for page bodies" << std::endl;
+  body_compressor.SetDictionary(std::move(dictionary));
+}
+
+bool IndexWriter::applyFrontierUpdate(const FrontierUpdate &frontier_update) {
+  // Runs a statement whose parameters are bound, and resets it
+  auto step = [&](sqlite3_stmt *stmt) {
+    bool is_done = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return is_done;
+  };
+
+  bool is_applied = true;
+  for (const std::string &link : frontier_update.queued_links) {
+    auto fingerprint =
+        static_cast<sqlite3_int64>(UrlFingerprintSet::Fingerprint(link));
+    sqlite3_bind_int64(insert_known_link_stmt.get(), 1, fingerprint);
+    is_applied = step(insert_known_link_stmt.get()) && is_applied;
+
+    sqlite3_bind_int64(queue_link_stmt.get(), 1, fingerprint);
+    sqlite3_bind_text(queue_link_stmt.get(), 2, link.data(),
+                      static_cast<int>(link.size()), SQLITE_STATIC);
+    is_applied = step(queue_link_stmt.get()) && is_applied;
+  }
+
+  for (std::uint64_t fingerprint : frontier_update.done_links) {
+    sqlite3_bind_int64(dequeue_link_stmt.get(), 1,
+                       static_cast<sqlite3_int64>(fingerprint));
+    is_applied = step(dequeue_link_stmt.get()) && is_applied;
+  }
+
+  for (const RobotsTxtRecord &robots_txt : frontier_update.robots_txts) {
+    sqlite3_stmt *stmt = upsert_robots_txt_stmt.get();
+    sqlite3_bind_text(stmt, 1, robots_txt.host.data(),
+                      static_cast<int>(robots_txt.host.size()), SQLITE_STATIC);
+    if (robots_txt.content.has_value()) {
+      sqlite3_bind_text(stmt, 2, robots_txt.content->data(),
+                        static_cast<int>(robots_txt.content->size()),
+                        SQLITE_STATIC);
+    } else {
+      sqlite3_bind_null(stmt, 2);
+    }
+    sqlite3_bind_int64(stmt, 3, robots_txt.fetched_at);
+    is_applied = step(stmt) && is_applied;
+  }
+
+  // Validators may be missing, and are bound as NULL then
+  auto bindOptionalText = [](sqlite3_stmt *stmt, int index,
+                             const std::optional<std::string> &text) {
+    if (text.has_value()) {
+      sqlite3_bind_text(stmt, index, text->data(),
+                        static_cast<int>(text->size()), SQLITE_STATIC);
+    } else {
+      sqlite3_bind_null(stmt, index);
+    }
+  };
+
+  for (const PageFetchRecord &page : frontier_update.fetched_pages) {
+    sqlite3_stmt *stmt = upsert_fetched_page_stmt.get();
+    sqlite3_bind_int64(stmt, 1,
+                       static_cast<sqlite3_int64>(
+                           UrlFingerprintSet::Fingerprint(page.url)));
+    sqlite3_bind_text(stmt, 2, page.url.data(),
+                      static_cast<int>(page.url.size()), SQLITE_STATIC);
+    bindOptionalText(stmt, 3, page.validators.etag);
+    bindOptionalText(stmt, 4, page.validators.last_modified);
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(page.content_hash));
+    sqlite3_bind_int64(stmt, 6, page.fetched_at);
+    sqlite3_bind_int64(stmt, 7, page.next_fetch_at);
+    sqlite3_bind_int64(stmt, 8, page.change_count);
+    sqlite3_bind_int64(stmt, 9, page.observed_seconds);
+    is_applied = step(stmt) && is_applied;
+  }
+
+  if (!is_applied) {
+    std::cerr << "Failed to write the crawl frontier to SQLite database: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+  }
+  return is_applied;
+}
+
+void IndexWriter::applyPragmas(const DatabaseOptions &db_options) {
+  // Only accept the documented values, as pragmas cannot take parameters
+  const std::string &synchronous = db_options.synchronous;
+  if (synchronous != "OFF" && synchronous != "NORMAL" &&
+      synchronous != "FULL" && synchronous != "EXTRA") {
+    throw std::runtime_error("Invalid SQLite synchronous mode: " +
+                             synchronous);
+  }
+
+  // WAL lets readers (the search server) work while a batch is written, and
+  // makes a commit a sequential append instead of a rollback journal dance.
+  std::string pragmas =
+      "PRAGMA journal_mode=WAL;"
+      "PRAGMA synchronous=" +
+      synchronous +
+      ";"
+      "PRAGMA cache_size=-" +
+      std::to_string(db_options.cache_size_kb) +
+      ";"
+      "PRAGMA mmap_size=" +
+      std::to_string(static_cast<long long>(db_options.mmap_size_mb) * 1024 *
+                     1024) +
+      ";";
+
+  char *err_msg = nullptr;
+  if (sqlite3_exec(db.get(), pragmas.c_str(), nullptr, nullptr, &err_msg) !=
+      SQLITE_OK) {
+    std::string error_msg = err_msg ? err_msg : "Unknown error";
+    sqlite3_free(err_msg);
+    throw std::runtime_error("Failed to configure SQLite database: " +
+                             error_msg);
+  }
+
+  sqlite3_busy_timeout(db.get(), 5000);
+}
+
+void IndexWriter::createGenerationTable() {
+  char *err_msg = nullptr;
+  if (sqlite3_exec(db.get(),
+                   "CREATE TABLE IF NOT EXISTS index_generation("
+                   "id INTEGER PRIMARY KEY CHECK (id = 0), "
+                   "generation INTEGER NOT NULL);"
+                   "INSERT OR IGNORE INTO index_generation VALUES (0, 0);",
+                   nullptr, nullptr, &err_msg) != SQLITE_OK) {
+    std::string error_msg = err_msg ? err_msg : "Unknown error";
+    sqlite3_free(err_msg);
+    throw std::runtime_error("Failed to create index generation table: " +
+                             error_msg);
+  }
+}
+
+void IndexWriter::createFrontierTables() {
+  // Links are keyed on their fingerprint, like in the known link set. The
+  // queue is kept in the order links were queued in by its rowid. Fetched
+  // pages are kept with what is needed to revisit them.
+  char *err_msg = nullptr;
+  if (sqlite3_exec(db.get(),
+                   "CREATE TABLE IF NOT EXISTS crawl_known_links("
+                   "fingerprint INTEGER PRIMARY KEY);"
+                   "CREATE TABLE IF NOT EXISTS crawl_queue("
+                   "id INTEGER PRIMARY KEY, "
+                   "fingerprint INTEGER NOT NULL UNIQUE, "
+                   "url TEXT NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS crawl_robots_txt("
+                   "host TEXT PRIMARY KEY, "
+                   "content TEXT, "
+                   "fetched_at INTEGER NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS crawl_pages("
+                   "fingerprint INTEGER PRIMARY KEY, "
+                   "url TEXT NOT NULL, "
+                   "etag TEXT, "
+                   "last_modified TEXT, "
+                   "content_hash INTEGER NOT NULL, "
+                   "fetched_at INTEGER NOT NULL, "
+                   "next_fetch_at INTEGER NOT NULL, "
+                   "change_count INTEGER NOT NULL, "
+                   "observed_seconds INTEGER NOT NULL);",
+                   nullptr, nullptr, &err_msg) != SQLITE_OK) {
+    std::string error_msg = err_msg ? err_msg : "Unknown error";
+    sqlite3_free(err_msg);
+    throw std::runtime_error("Failed to create crawl frontier tables: " +
+                             error_msg);
+  }
+}
+
+void IndexWriter::createDuplicateTables() {
+  // Hashes are stored as the signed integers they are bound as
+  char *err_msg = nullptr;
+  if (sqlite3_exec(db.get(),
+                   "CREATE TABLE IF NOT EXISTS crawl_signatures("
+                   "fingerprint INTEGER PRIMARY KEY, "
+                   "url TEXT NOT NULL, "
+                   "text_hash_high INTEGER NOT NULL, "
+                   "text_hash_low INTEGER NOT NULL, "
+                   "simhash INTEGER NOT NULL, "
+                   "word_count INTEGER NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS crawl_aliases("
+                   "url TEXT PRIMARY KEY, "
+                   "canonical_url TEXT NOT NULL);",
+                   nullptr, nullptr, &err_msg) != SQLITE_OK) {
+    std::string error_msg = err_msg ? err_msg : "Unknown error";
+    sqlite3_free(err_msg);
+    throw std::runtime_error("Failed to create duplicate tables: " +
+                             error_msg);
+  }
+}
+
+void IndexWriter::createBodyTables() {
+  // A body without a dictionary was compressed before one was trained
+  char *err_msg = nullptr;
+  if (sqlite3_exec(db.get(),
+                   "CREATE TABLE IF NOT EXISTS body_dictionaries("
+                   "id INTEGER PRIMARY KEY, "
+                   "dictionary BLOB NOT NULL);"
+                   "CREATE TABLE IF NOT EXISTS webpage_bodies("
+                   "url TEXT PRIMARY KEY, "
+                   "dictionary_id INTEGER, "
+                   "size INTEGER NOT NULL, "
+                   "body BLOB NOT NULL);",
+                   nullptr, nullptr, &err_msg) != SQLITE_OK) {
+    std::string error_msg = err_msg ? err_msg : "Unknown error";
+    sqlite3_free(err_msg);
+    throw std::runtime_error("Failed to create page body tables: " +
+                             error_msg);
+  }
+}
+
+FrontierSnapshot IndexWriter::loadFrontier() {
+  FrontierSnapshot snapshot;
+
+  auto stmt = prepareStatement("SELECT fingerprint FROM crawl_known_links;");
+  while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+    snapshot.known_links.push_back(
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 0)));
+  }
+
+  stmt = prepareStatement("SELECT url FROM crawl_queue ORDER BY id;");
+  while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+    auto url = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+    snapshot.queued_links.emplace_back(
+        url, static_cast<std::size_t>(sqlite3_column_bytes(stmt.get(), 0)));
+  }
+
+  stmt = prepareStatement(
+      "SELECT host, content, fetched_at FROM crawl_robots_txt;");
+  while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+    RobotsTxtRecord &robots_txt = snapshot.robots_txts.emplace_back();
+    robots_txt.host = reinterpret_cast<const char *>(
+        sqlite3_column_text(stmt.get(), 0));
+    if (sqlite3_column_type(stmt.get(), 1) != SQLITE_NULL) {
+      robots_txt.content.emplace(
+          reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 1)),
+          static_cast<std::size_t>(sqlite3_column_bytes(stmt.get(), 1)));
+    }
+    robots_txt.fetched_at = sqlite3_column_int64(stmt.get(), 2);
+  }
+
+  return snapshot;
+}
+
+std::vector<IndexedPageSignature> IndexWriter::loadSignatures() {
+  std::vector<IndexedPageSignature> signatures;
+  auto stmt = prepareStatement(
+      "SELECT fingerprint, text_hash_high, text_hash_low, simhash, "
+      "word_count FROM crawl_signatures;");
+  while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+    IndexedPageSignature &page = signatures.emplace_back();
+    page.fingerprint =
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 0));
+    page.signature.text_hash = {
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 1)),
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 2))};
+    page.signature.simhash =
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 3));
+    page.signature.word_count =
+        static_cast<std::uint32_t>(sqlite3_column_int64(stmt.get(), 4));
+  }
+  return signatures;
+}
+
+void IndexWriter::loadDictionary() {
+  auto stmt = prepareStatement(
+      "SELECT id, dictionary FROM body_dictionaries ORDER BY id DESC LIMIT 1;");
+  if (sqlite3_step(stmt.get()) != SQLITE_ROW ||
+      sqlite3_column_bytes(stmt.get(), 1) == 0) {
+    return;
+  }
+  dictionary_id = sqlite3_column_int64(stmt.get(), 0);
+  body_compressor.SetDictionary(std::string(
+      static_cast<const char *>(sqlite3_column_blob(stmt.get(), 1)),
+      static_cast<std::size_t>(sqlite3_column_bytes(stmt.get(), 1))));
+}
+
+std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>
+IndexWriter::prepareStatement(const char *sql) {
+  sqlite3_stmt *raw_stmt = nullptr;
+  if (sqlite3_prepare_v2(db.get(), sql, -1, &raw_stmt, nullptr) != SQLITE_OK) {
+    std::string error_msg = sqlite3_errmsg(db.get());
+    throw std::runtime_error("Failed to prepare SQLite statement: " +
+                             error_msg);
+  }
+  return std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>(raw_stmt);
+}
+
+bool IndexWriter::beginBatch() {
+  int result = sqlite3_step(begin_stmt.get());
+  sqlite3_reset(begin_stmt.get());
+  if (result != SQLITE_DONE) {
+    std::cerr << "Failed to begin SQLite transaction: "
+              << sqlite3_errmsg(db.get()) << std::endl;
+    return false;
+  }
+
+  is_in_transaction = true;
+  batch_start_time = std::chrono::steady_clock::now();
   return true;
 }
+
+bool IndexWriter::flushIfDue() {
+  if (is_in_transaction &&
+      std::chrono::steady_clock::now() - batch_start_time >= batch_interval) {
+    return flush();
+  }
+  return true;
+}
+
+bool IndexWriter::flush() {
+  if (!is_in_transaction) {
+    return true;
+  }
+
+  // Bumped in the same transaction, so it changes exactly when pages do. A
+  // batch of frontier changes alone leaves it as it is.
+  int result = SQLITE_DONE;
+  if (has_index_changes) {
+    result = sqlite3_step(bump_generation_stmt.get());
+    sqlite3_reset(bump_generation_stmt.get());
+  }
+  if (result == SQLITE_DONE) {
+    result = sqlite3_step(commit_stmt.get());
+    sqlite3_reset(commit_stmt.get());
+  }
+  if (result != SQLITE_DONE) {
+    std::cerr << "Failed to commit " << batch_page_count
+              << " pages to SQLite database: " << sqlite3_errmsg(db.get())
+              << std::endl;
+    sqlite3_exec(db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+  }
+
+  is_in_transaction = false;
+  batch_page_count = 0;
+  has_index_changes = false;
+  return result == SQLITE_DONE;
+}
 } // namespace crawler
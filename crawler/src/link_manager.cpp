@@ -2,7 +2,9 @@
 #include "link_manager.hpp"
 
 #include <ada.h>
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include "config.hpp"
 #include "options.hpp"
@@ -11,130 +13,369 @@
 
 namespace crawler {
 
+namespace {
+
+// Wait before retrying a robots.txt that could not be fetched, and the number
+// of attempts after which the host is given up on.
+constexpr auto kRobotsTxtRetryDelay = std::chrono::minutes(10);
+constexpr int kMaxRobotsTxtFailures = 5;
+
+// A host without a warm connection is passed over for hosts with one for at
+// most this long after it may be contacted, and only while no more than
+// kMaxPassedOverHosts hosts are waiting.
+constexpr auto kMaxColdHostWait = std::chrono::seconds(1);
+constexpr std::size_t kMaxPassedOverHosts = 64;
+
+} // namespace
+
 LinkManager::LinkManager(const std::vector<std::string> &seed_links,
-                         const int default_delay) {
-  this->default_delay = default_delay;
+                         const CrawlOptions &crawl_options,
+                         FrontierSnapshot restored_frontier)
+    : all_known_links(static_cast<std::size_t>(
+                          crawl_options.known_links_memory_limit_mb) *
+                      1024 * 1024) {
+  this->default_delay = crawl_options.default_delay;
+  this->robots_txt_cache_ttl =
+      std::chrono::seconds(crawl_options.robots_txt_cache_ttl);
+
+  std::vector<NormalizedUrl> seed_urls;
   for (const auto &link : seed_links) {
-    this->seed_links.insert(link);
-    links_to_visit.push(link);
-    all_known_links.insert(link);
-
-    std::string host = utils::GetHostFromUrl(link);
-    if (!robots_txt_parsers.contains(host)) {
-      std::cout << "Fetching robots.txt for host: " << host << std::endl;
-
-      WebCrawler web_crawler;
-      std::optional<PageResult> robots_txt_result =
-          web_crawler.GetPage(utils::GetBaseUrl(link) + "/robots.txt");
-      if (robots_txt_result.has_value() &&
-          robots_txt_result->content.has_value()) {
-        robots_txt_parsers[host] =
-            std::make_unique<RobotsParser>(robots_txt_result->content.value());
-      } else {
-        // If robots.txt is not found, we assume an "allow all" policy
-        robots_txt_parsers[utils::GetHostFromUrl(link)] =
-            std::make_unique<RobotsParser>();
-      }
+    std::optional<NormalizedUrl> seed_url =
+        ParseUrl(link, nullptr, host_table);
+    if (!seed_url.has_value()) {
+      std::cerr << "Invalid seed link: " << link << std::endl;
+      continue;
+    }
+    this->seed_links.push_back(seed_url->href);
+    seed_urls.push_back(std::move(*seed_url));
+  }
+
+  restoreFrontier(std::move(restored_frontier));
+
+  // robots.txt is fetched lazily, when the host is first scheduled
+  for (NormalizedUrl &seed_url : seed_urls) {
+    if (all_known_links.Insert(seed_url.href)) {
+      queueNewLink(std::move(seed_url));
     }
   }
 }
 
-void LinkManager::AddDiscoveredLinks(const std::vector<std::string> &links,
-                                     const std::string &source_link) {
-  // Links discovered means that the source link has been visited
-  MarkLinkAsVisited(source_link);
+void LinkManager::AddDiscoveredLinks(const PageResult &page_result,
+                                     const NormalizedUrl &source_link) {
+  // Parse the page URL once; every link on the page is resolved against it,
+  // or against the page's <base href> if that is a valid URL itself.
+  auto base_url = ada::parse<ada::url_aggregator>(source_link.href);
+  if (!base_url) {
+    return;
+  }
+
+  if (page_result.redirect_url.has_value()) {
+    addDiscoveredLink(*page_result.redirect_url, *base_url);
+  }
 
-  for (const auto &link : links) {
-    if (isRelativeLink(link)) {
-      // Add the domain from the source link to the relative link and add it to
-      // the links to visit
-      std::string full_link;
+  if (page_result.base_url.has_value()) {
+    std::string base_href = utils::DecodeHtmlEntities(utils::TrimWhitespace(
+        page_result.GetText(*page_result.base_url)));
+    if (auto declared_base_url =
+            ada::parse<ada::url_aggregator>(base_href, &*base_url)) {
+      base_url = std::move(declared_base_url);
+    }
+  }
 
-      if (link[0] == '/') {
-        // If the link is a relative path, we need to prepend the source domain
-        full_link = utils::GetBaseUrl(source_link) + link;
-      } else if (link[0] == '#') {
-        // If the link is a fragment (starts with '#'), we can skip it
+  for (const auto &span : page_result.links) {
+    // Links are raw attribute values; only decode the ones that need it.
+    std::string_view link = utils::TrimWhitespace(page_result.GetText(span));
+    if (link.find('&') != std::string_view::npos) {
+      addDiscoveredLink(utils::DecodeHtmlEntities(link), *base_url);
+    } else {
+      addDiscoveredLink(link, *base_url);
+    }
+  }
+}
+
+bool LinkManager::QueueRevisit(std::string_view link) {
+  std::optional<NormalizedUrl> url = ParseUrl(link, nullptr, host_table);
+  if (!url.has_value() || !isBasedOnSeedLink(url->href)) {
+    return false;
+  }
+  enqueueLink(std::move(*url));
+  return true;
+}
+
+void LinkManager::MarkLinkAsVisited(const NormalizedUrl &link) {
+  frontier_update.done_links.push_back(
+      UrlFingerprintSet::Fingerprint(link.href));
+  markHostAsVisited(link.host_id);
+}
+
+FrontierUpdate LinkManager::TakeFrontierUpdate() {
+  return std::exchange(frontier_update, FrontierUpdate{});
+}
+
+bool LinkManager::HasLinksToVisit() const { return links_to_visit_count > 0; }
+
+std::optional<FetchRequest> LinkManager::GetNextLinkToVisit(
+    const std::function<bool(HostId)> &has_warm_connection) {
+  auto now = std::chrono::steady_clock::now();
+
+  // Hosts passed over for a warm one, in the order they became ready. They
+  // stay scheduled and go back to the schedule as they were.
+  std::vector<ScheduledHost> passed_over_hosts;
+  std::size_t next_passed_over_host = 0;
+  std::optional<FetchRequest> request;
+  while (!request.has_value()) {
+    HostId host_id;
+    if (!host_schedule.empty() && host_schedule.top().first <= now) {
+      ScheduledHost host = host_schedule.top();
+      host_schedule.pop();
+      if (has_warm_connection && !has_warm_connection(host.second) &&
+          now - host.first < kMaxColdHostWait &&
+          passed_over_hosts.size() < kMaxPassedOverHosts) {
+        passed_over_hosts.push_back(host);
         continue;
-      } else {
-        // If the link is a relative URL (not starting with '/'), we need to
-        // prepend the source url (remove any trailing slashes)
-        std::string source_link_string = source_link;
-        if (source_link_string.back() == '/') {
-          source_link_string.pop_back(); // Remove trailing slash if present
-        }
-        full_link = source_link_string + '/' + link;
       }
+      host_id = host.second;
+    } else if (next_passed_over_host < passed_over_hosts.size()) {
+      host_id = passed_over_hosts[next_passed_over_host++].second;
+    } else {
+      break;
+    }
+    request = takeNextFetch(host_id, now);
+  }
 
-      if (isBasedOnSeedLink(full_link) &&
-          all_known_links.find(full_link) == all_known_links.end()) {
-        links_to_visit.push(full_link);
-        all_known_links.insert(full_link);
-      }
-    } else if (isBasedOnSeedLink(link)) {
-      // check if the link is based on a seed link
-      if (all_known_links.find(link) == all_known_links.end()) {
-        links_to_visit.push(link);
-        all_known_links.insert(link);
+  for (std::size_t i = next_passed_over_host; i < passed_over_hosts.size();
+       ++i) {
+    host_schedule.push(passed_over_hosts[i]);
+  }
+  return request;
+}
+
+void LinkManager::HandleRobotsTxt(const FetchResult &fetch_result) {
+  HostId host_id = fetch_result.url.host_id;
+  HostQueue &host_queue = host_queues.at(host_id);
+  auto now = std::chrono::steady_clock::now();
+  std::int64_t fetched_at =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+
+  if (fetch_result.page.has_value() && fetch_result.page->content.has_value()) {
+    std::string content =
+        fetch_result.page->content->substr(0, kMaxRobotsTxtSize);
+    robots_txt_parsers[host_id] =
+        std::make_unique<RobotsParser>(content, SEARCHLIGHT_CRAWLER_USER_AGENT);
+    host_queue.robots_txt_expiry = now + robots_txt_cache_ttl;
+    host_queue.robots_txt_failures = 0;
+    frontier_update.robots_txts.push_back(
+        {.host = host_table.GetHost(host_id),
+         .content = std::move(content),
+         .fetched_at = fetched_at});
+  } else if (fetch_result.http_code >= 300 && fetch_result.http_code < 500) {
+    // Unavailable (4xx, or too many redirects): we assume an "allow all"
+    // policy
+    robots_txt_parsers[host_id] = std::make_unique<RobotsParser>();
+    host_queue.robots_txt_expiry = now + robots_txt_cache_ttl;
+    host_queue.robots_txt_failures = 0;
+    frontier_update.robots_txts.push_back({.host = host_table.GetHost(host_id),
+                                           .content = std::nullopt,
+                                           .fetched_at = fetched_at});
+  } else {
+    // Unreachable (5xx or network error): crawling is disallowed until a
+    // retry succeeds. A previously fetched robots.txt stays in effect.
+    host_queue.robots_txt_expiry = now + kRobotsTxtRetryDelay;
+    if (++host_queue.robots_txt_failures >= kMaxRobotsTxtFailures &&
+        !robots_txt_parsers.contains(host_id)) {
+      std::cerr << "Giving up on host " << host_table.GetHost(host_id)
+                << ", robots.txt is unreachable" << std::endl;
+      links_to_visit_count -= host_queue.links.size();
+      for (; !host_queue.links.empty(); host_queue.links.pop()) {
+        frontier_update.done_links.push_back(
+            UrlFingerprintSet::Fingerprint(host_queue.links.front().href));
       }
     } else {
-      // If the link is not relative and not based on a seed link, we can skip
-      continue;
+      std::cerr << "robots.txt unreachable for host "
+                << host_table.GetHost(host_id) << ", retrying later"
+                << std::endl;
     }
   }
+
+  markHostAsVisited(host_id);
 }
 
-void LinkManager::MarkLinkAsVisited(const std::string &link) {
-  visited_hosts[utils::GetHostFromUrl(link)] = std::chrono::steady_clock::now();
+std::optional<std::chrono::steady_clock::time_point>
+LinkManager::GetNextVisitTime() const {
+  if (host_schedule.empty()) {
+    return std::nullopt;
+  }
+  return host_schedule.top().first;
 }
 
-bool LinkManager::HasLinksToVisit() const { return !links_to_visit.empty(); }
+bool LinkManager::IsCrawlAllowed(const NormalizedUrl &link) const {
+  if (auto it = robots_txt_parsers.find(link.host_id);
+      it != robots_txt_parsers.end()) {
+    return it->second->IsAllowed(link.GetPath());
+  }
 
-std::string LinkManager::GetNextLinkToVisit() {
-  if (links_to_visit.empty()) {
-    return "";
+  return true; // If no robots.txt is found, allow by default
+}
+
+const UrlFingerprintSet &LinkManager::GetKnownLinks() const {
+  return all_known_links;
+}
+
+// Private methods
+
+void LinkManager::addDiscoveredLink(std::string_view link,
+                                    const ada::url_aggregator &base_url) {
+  std::optional<NormalizedUrl> url = ParseUrl(link, &base_url, host_table);
+
+  // Only keep valid links that are based on a seed link and not seen before
+  if (url.has_value() && isBasedOnSeedLink(url->href) &&
+      all_known_links.Insert(url->href)) {
+    queueNewLink(std::move(*url));
+  }
+}
+
+void LinkManager::restoreFrontier(FrontierSnapshot restored_frontier) {
+  auto now = std::chrono::steady_clock::now();
+  std::int64_t now_seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+
+  // A robots.txt is used for what remains of its TTL
+  for (RobotsTxtRecord &robots_txt : restored_frontier.robots_txts) {
+    auto age = std::chrono::seconds(now_seconds - robots_txt.fetched_at);
+    if (age < std::chrono::seconds(0) || age >= robots_txt_cache_ttl) {
+      continue;
+    }
+    HostId host_id = host_table.Intern(robots_txt.host);
+    robots_txt_parsers[host_id] =
+        robots_txt.content.has_value()
+            ? std::make_unique<RobotsParser>(*robots_txt.content,
+                                             SEARCHLIGHT_CRAWLER_USER_AGENT)
+            : std::make_unique<RobotsParser>();
+    host_queues[host_id].robots_txt_expiry = now + robots_txt_cache_ttl - age;
+  }
+
+  for (std::uint64_t fingerprint : restored_frontier.known_links) {
+    all_known_links.InsertFingerprint(fingerprint);
+  }
+
+  for (const std::string &link : restored_frontier.queued_links) {
+    std::optional<NormalizedUrl> url = ParseUrl(link, nullptr, host_table);
+    if (!url.has_value() || !isBasedOnSeedLink(url->href)) {
+      frontier_update.done_links.push_back(
+          UrlFingerprintSet::Fingerprint(link));
+      continue;
+    }
+    // The previous run may have fetched from the host moments ago
+    visited_hosts[url->host_id] = now;
+    enqueueLink(std::move(*url));
+  }
+
+  if (!restored_frontier.known_links.empty()) {
+    std::cout << "Resuming crawl with " << all_known_links.Size()
+              << " known links, " << links_to_visit_count << " of them queued"
+              << std::endl;
   }
-  // Get the first link to visit
-  std::string next_link = links_to_visit.front();
-  links_to_visit.pop();
-  return next_link;
 }
 
-void LinkManager::RequeLink(const std::string &link) {
-  // Requeue the link to visit again
-  links_to_visit.push(link);
+void LinkManager::queueNewLink(NormalizedUrl link) {
+  frontier_update.queued_links.push_back(link.href);
+  enqueueLink(std::move(link));
 }
 
-bool LinkManager::IsCrawlAllowed(const std::string &link) const {
-  auto host = utils::GetHostFromUrl(link);
-  if (robots_txt_parsers.contains(host)) {
-    bool is_allowed = robots_txt_parsers.at(host)->IsAllowed(
-        utils::GetPathFromUrl(link), SEARCHLIGHT_CRAWLER_USER_AGENT);
-    return is_allowed;
+void LinkManager::enqueueLink(NormalizedUrl link) {
+  HostId host_id = link.host_id;
+  HostQueue &host_queue = host_queues[host_id];
+  host_queue.links.push(std::move(link));
+  ++links_to_visit_count;
+  scheduleHost(host_id, host_queue);
+}
+
+void LinkManager::markHostAsVisited(HostId host_id) {
+  visited_hosts[host_id] = std::chrono::steady_clock::now();
+
+  if (auto it = host_queues.find(host_id); it != host_queues.end()) {
+    it->second.is_in_flight = false;
+    scheduleHost(host_id, it->second);
   }
+}
 
-  return true; // If no robots.txt is found, allow by default
+std::optional<FetchRequest>
+LinkManager::takeNextFetch(HostId host_id,
+                           std::chrono::steady_clock::time_point now) {
+  HostQueue &host_queue = host_queues.at(host_id);
+  host_queue.is_scheduled = false;
+
+  if (host_queue.robots_txt_expiry <= now) {
+    const NormalizedUrl &link = host_queue.links.front();
+    std::string origin(link.GetOrigin());
+    std::cout << "Fetching robots.txt for host: "
+              << host_table.GetHost(host_id) << std::endl;
+
+    host_queue.is_in_flight = true;
+    return FetchRequest{
+        .url = NormalizedUrl{.href = origin + "/robots.txt",
+                             .host_id = host_id,
+                             .path_offset =
+                                 static_cast<std::uint32_t>(origin.size())},
+        .kind = FetchKind::RobotsTxt};
+  }
+
+  while (!host_queue.links.empty()) {
+    NormalizedUrl next_link = std::move(host_queue.links.front());
+    host_queue.links.pop();
+    --links_to_visit_count;
+
+    if (!IsCrawlAllowed(next_link)) {
+      std::cout << "Skipping disallowed link: " << next_link.href
+                << std::endl;
+      frontier_update.done_links.push_back(
+          UrlFingerprintSet::Fingerprint(next_link.href));
+      continue;
+    }
+
+    host_queue.is_in_flight = true;
+    return FetchRequest{.url = std::move(next_link), .kind = FetchKind::Page};
+  }
+
+  return std::nullopt;
 }
 
-bool LinkManager::HasEnoughDelay(const std::string &link) const {
-  auto host = utils::GetHostFromUrl(link);
-  if (visited_hosts.contains(host)) {
-    int crawl_delay = robots_txt_parsers.at(host)
-                          ->GetCrawlDelay(SEARCHLIGHT_CRAWLER_USER_AGENT)
-                          .value_or(default_delay);
-    return std::chrono::steady_clock::now() - visited_hosts.at(host) >=
-           std::chrono::seconds(crawl_delay);
+void LinkManager::scheduleHost(HostId host_id, HostQueue &host_queue) {
+  if (host_queue.is_scheduled || host_queue.is_in_flight ||
+      host_queue.links.empty()) {
+    return;
   }
-  return true; // If no previous visit, allow by default
+
+  host_schedule.emplace(getNextAllowedVisit(host_id), host_id);
+  host_queue.is_scheduled = true;
 }
 
-// Private methods
+std::chrono::steady_clock::time_point
+LinkManager::getNextAllowedVisit(HostId host_id) const {
+  auto visited_it = visited_hosts.find(host_id);
+  if (visited_it == visited_hosts.end()) {
+    return std::chrono::steady_clock::now(); // Never visited, allow right away
+  }
 
-bool LinkManager::isRelativeLink(const std::string &link) const {
-  return !(link.starts_with("http"));
+  int crawl_delay = default_delay;
+  auto it = robots_txt_parsers.find(host_id);
+  if (it != robots_txt_parsers.end()) {
+    crawl_delay = it->second->GetCrawlDelay().value_or(default_delay);
+  }
+  auto next_visit = visited_it->second + std::chrono::seconds(crawl_delay);
+
+  // A host without a usable robots.txt waits for its next robots.txt fetch
+  if (it == robots_txt_parsers.end()) {
+    next_visit = std::max(next_visit, host_queues.at(host_id).robots_txt_expiry);
+  }
+  return next_visit;
 }
 
-bool LinkManager::isBasedOnSeedLink(const std::string &link) const {
+bool LinkManager::isBasedOnSeedLink(std::string_view link) const {
   for (const auto &seed_link : seed_links) {
     if (link.starts_with(seed_link)) {
       return true;
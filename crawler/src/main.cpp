@@ -1,64 +1,165 @@
 // SPDX-License-Identifier: AGPL-3.0-only
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <optional>
-#include <thread>
+#include <string>
 
 #include "config.hpp"
+#include "duplicate_detector.hpp"
 #include "index_writer.hpp"
 #include "link_manager.hpp"
 #include "options.hpp"
+#include "revisit_scheduler.hpp"
 #include "web_crawler.hpp"
 #include <yaml-cpp/yaml.h>
 
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void requestStop(int) { stop_requested = 1; }
+
+} // namespace
+
 int main() {
   YAML::Node options_node = YAML::LoadFile(OPTIONS_FILE_PATH);
   crawler::Options options(options_node);
-  crawler::LinkManager link_manager(options.seed_links,
-                                    options.crawl_options->default_delay);
-  crawler::WebCrawler web_crawler;
+  std::string db_path = options.database_options->db_path;
+  // The frontier of the previous run, if any, is read from the database
   crawler::IndexWriter index_writer(std::move(options.database_options));
+  crawler::LinkManager link_manager(options.seed_links,
+                                    *options.crawl_options,
+                                    index_writer.TakeRestoredFrontier());
+  crawler::RevisitScheduler revisit_scheduler(db_path, *options.crawl_options);
+  crawler::DuplicateDetector duplicate_detector(
+      index_writer.TakeRestoredSignatures());
+  crawler::WebCrawler web_crawler(*options.crawl_options);
 
-  while (link_manager.HasLinksToVisit()) {
-    std::string link = link_manager.GetNextLinkToVisit();
-    if (!link_manager.IsCrawlAllowed(link)) {
-      std::cout << "Skipping disallowed link: " << link << std::endl;
-      // Mark the link as visited and continue to the next one
-      link_manager.MarkLinkAsVisited(link);
-      continue;
+  // Frontier changes come from the link manager, fetch records from the
+  // revisit scheduler
+  auto takeFrontierUpdate = [&] {
+    crawler::FrontierUpdate frontier_update =
+        link_manager.TakeFrontierUpdate();
+    frontier_update.fetched_pages = revisit_scheduler.TakeFetchedPages();
+    return frontier_update;
+  };
+
+  // Stop crawling on SIGINT/SIGTERM, but still write what has been fetched
+  std::signal(SIGINT, requestStop);
+  std::signal(SIGTERM, requestStop);
+
+  while (!stop_requested &&
+         (link_manager.HasLinksToVisit() || web_crawler.HasPendingPages() ||
+          revisit_scheduler.HasDueRevisits())) {
+    // Pages due for a revisit go through the same host queues as new links
+    for (const std::string &link : revisit_scheduler.TakeDueRevisits()) {
+      if (!link_manager.QueueRevisit(link)) {
+        std::cout << "Skipping revisit of link outside the seeds: " << link
+                  << std::endl;
+        revisit_scheduler.DropRevisit(link);
+      }
     }
 
-    if (!link_manager.HasEnoughDelay(link)) {
-      std::cout << "Waiting for delay, link requeued: " << link << std::endl;
-      // Requeue the link to visit again later
-      link_manager.RequeLink(link);
-      // wait for a while before checking the next link
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      continue;
+    // Hand out links until every transfer slot is busy or no host is ready.
+    // Nothing new is fetched while the index writer is behind.
+    while (web_crawler.HasFreeSlot() && !index_writer.IsBacklogged()) {
+      std::optional<crawler::FetchRequest> request =
+          link_manager.GetNextLinkToVisit([&](crawler::HostId host_id) {
+            return web_crawler.HasWarmConnection(host_id);
+          });
+      if (!request.has_value()) {
+        break;
+      }
+      revisit_scheduler.AddValidators(*request);
+      // A fetch that cannot be started comes back as a failed one; try the
+      // next links once it has been handled
+      if (!web_crawler.SubmitPage(std::move(*request))) {
+        break;
+      }
     }
 
-    std::optional<crawler::PageResult> page_result = web_crawler.GetPage(link);
-    link_manager.MarkLinkAsVisited(link);
-    std::cout << "Visited: " << link << std::endl;
+    // Sleep until there is network activity or, if a slot is free, until the
+    // next host becomes ready.
+    auto timeout = std::chrono::milliseconds(1000);
+    auto next_visit_time = link_manager.GetNextVisitTime();
+    if (next_visit_time.has_value() && web_crawler.HasFreeSlot() &&
+        !index_writer.IsBacklogged()) {
+      auto until_next_visit =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              *next_visit_time - std::chrono::steady_clock::now());
+      timeout = std::clamp(until_next_visit, std::chrono::milliseconds(0),
+                           timeout);
+    }
+    web_crawler.Perform(timeout);
+
+    while (std::optional<crawler::FetchResult> fetch_result =
+               web_crawler.PopCompletedPage()) {
+      if (fetch_result->kind == crawler::FetchKind::RobotsTxt) {
+        link_manager.HandleRobotsTxt(*fetch_result);
+        index_writer.EnqueueFrontierUpdate(takeFrontierUpdate());
+        continue;
+      }
 
-    if (page_result.has_value()) {
-      link_manager.AddDiscoveredLinks(page_result->links, link);
+      const crawler::NormalizedUrl &url = fetch_result->url;
+      const std::string &link = url.href;
+      link_manager.MarkLinkAsVisited(url);
+      bool is_changed = revisit_scheduler.HandleFetch(*fetch_result);
+      std::cout << "Visited: " << link << std::endl;
+
+      std::optional<crawler::PageResult> &page_result = fetch_result->page;
+      if (fetch_result->http_code == 304) {
+        std::cout << "Page not modified: " << link << std::endl;
+      } else if (page_result.has_value() && page_result->content.has_value()) {
+        // An unchanged page has the links it had, which are known already.
+        // A duplicate is neither indexed nor followed: its canonical page is.
+        std::optional<std::uint64_t> canonical_fingerprint;
+        if (is_changed) {
+          canonical_fingerprint = duplicate_detector.FindCanonicalPage(
+              link, page_result->content_signature);
+        }
 
-      if (page_result->content.has_value()) {
-        std::cout << "Inserting page into index: " << link << std::endl;
-        if (index_writer.InsertPage(link, *page_result)) {
-          std::cout << "Page inserted successfully." << std::endl;
+        if (!is_changed) {
+          std::cout << "Page unchanged: " << link << std::endl;
+        } else if (canonical_fingerprint.has_value()) {
+          std::cout << "Duplicate page: " << link << std::endl;
+          index_writer.EnqueueDuplicate(link, *canonical_fingerprint,
+                                        takeFrontierUpdate());
         } else {
-          std::cout << "Failed to insert page into index: " << link
-                    << std::endl;
+          link_manager.AddDiscoveredLinks(*page_result, url);
+
+          // The page is written along with the links found on it
+          std::cout << "Queueing page for the index: " << link << std::endl;
+          if (!index_writer.EnqueuePage(link, std::move(*page_result),
+                                        takeFrontierUpdate())) {
+            std::cout << "Failed to queue page for the index: " << link
+                      << std::endl;
+          }
         }
-      } else {
+      } else if (page_result.has_value()) {
+        link_manager.AddDiscoveredLinks(*page_result, url);
         std::cout << "Page content is missing for: " << link << std::endl;
+      } else {
+        std::cout << "Failed to retrieve page content from: " << link
+                  << std::endl;
       }
-    } else {
-      std::cout << "Failed to retrieve page content from: " << link
-                << std::endl;
+      index_writer.EnqueueFrontierUpdate(takeFrontierUpdate());
     }
   }
 
+  const crawler::UrlFingerprintSet &known_links = link_manager.GetKnownLinks();
+  std::cout << "Known links: " << known_links.Size() << " ("
+            << known_links.GetMemoryUsage() / (1024 * 1024)
+            << " MiB), false positive rate "
+            << known_links.GetFalsePositiveRate() << ", "
+            << known_links.GetRejectedCount() << " dropped" << std::endl;
+
+  // Links still in flight stay queued, and are fetched again on restart
+  index_writer.EnqueueFrontierUpdate(takeFrontierUpdate());
+  if (!index_writer.Drain()) {
+    std::cerr << "Failed to write the last pages to the index" << std::endl;
+    return 1;
+  }
   return 0;
 }
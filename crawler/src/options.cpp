@@ -1,15 +1,46 @@
 #include "options.hpp"
 #include "config.hpp"
 
-crawler::CrawlOptions::CrawlOptions() : default_delay(DEFAULT_CRAWL_DELAY) {}
+crawler::CrawlOptions::CrawlOptions()
+    : default_delay(DEFAULT_CRAWL_DELAY),
+      max_concurrent_requests(MAX_CONCURRENT_REQUESTS),
+      known_links_memory_limit_mb(KNOWN_LINKS_MEMORY_LIMIT_MB),
+      robots_txt_cache_ttl(ROBOTS_TXT_CACHE_TTL),
+      revisit_min_interval(REVISIT_MIN_INTERVAL),
+      revisit_max_interval(REVISIT_MAX_INTERVAL),
+      revisits_per_minute(REVISITS_PER_MINUTE),
+      max_body_size_kb(MAX_BODY_SIZE_KB), connect_timeout(CONNECT_TIMEOUT),
+      request_timeout(REQUEST_TIMEOUT), low_speed_limit(LOW_SPEED_LIMIT),
+      low_speed_time(LOW_SPEED_TIME),
+      max_cached_connections(MAX_CACHED_CONNECTIONS),
+      connection_max_idle(CONNECTION_MAX_IDLE),
+      dns_cache_timeout(DNS_CACHE_TIMEOUT) {}
 crawler::CrawlOptions::CrawlOptions(int default_delay)
-    : default_delay(default_delay) {}
+    : default_delay(default_delay),
+      max_concurrent_requests(MAX_CONCURRENT_REQUESTS),
+      known_links_memory_limit_mb(KNOWN_LINKS_MEMORY_LIMIT_MB),
+      robots_txt_cache_ttl(ROBOTS_TXT_CACHE_TTL),
+      revisit_min_interval(REVISIT_MIN_INTERVAL),
+      revisit_max_interval(REVISIT_MAX_INTERVAL),
+      revisits_per_minute(REVISITS_PER_MINUTE),
+      max_body_size_kb(MAX_BODY_SIZE_KB), connect_timeout(CONNECT_TIMEOUT),
+      request_timeout(REQUEST_TIMEOUT), low_speed_limit(LOW_SPEED_LIMIT),
+      low_speed_time(LOW_SPEED_TIME),
+      max_cached_connections(MAX_CACHED_CONNECTIONS),
+      connection_max_idle(CONNECTION_MAX_IDLE),
+      dns_cache_timeout(DNS_CACHE_TIMEOUT) {}
 
 crawler::DatabaseOptions::DatabaseOptions()
-    : db_path(DB_PATH), fts_html_ext_path(FTS_HTML_EXT_PATH) {}
+    : DatabaseOptions(DB_PATH, FTS_HTML_EXT_PATH) {}
 crawler::DatabaseOptions::DatabaseOptions(const std::string &db_path,
                                           const std::string &fts_html_ext_path)
-    : db_path(db_path), fts_html_ext_path(fts_html_ext_path) {}
+    : db_path(db_path), fts_html_ext_path(fts_html_ext_path),
+      batch_size(DB_BATCH_SIZE), batch_interval_ms(DB_BATCH_INTERVAL_MS),
+      queue_capacity(DB_QUEUE_CAPACITY),
+      compression_level(DB_COMPRESSION_LEVEL),
+      dictionary_sample_pages(DB_DICTIONARY_SAMPLE_PAGES),
+      synchronous(DB_SYNCHRONOUS),
+      cache_size_kb(DB_CACHE_SIZE_KB), mmap_size_mb(DB_MMAP_SIZE_MB) {}
 
 crawler::Options::Options() {
   crawl_options = std::make_unique<CrawlOptions>();
@@ -28,6 +59,58 @@ crawler::Options::Options(const YAML::Node &options_node) {
                             ? crawl_node["default-delay"].as<int>()
                             : DEFAULT_CRAWL_DELAY;
     crawl_options = std::make_unique<CrawlOptions>(default_delay);
+    if (crawl_node["max-concurrent-requests"]) {
+      crawl_options->max_concurrent_requests =
+          crawl_node["max-concurrent-requests"].as<int>();
+    }
+    if (crawl_node["known-links-memory-limit-mb"]) {
+      crawl_options->known_links_memory_limit_mb =
+          crawl_node["known-links-memory-limit-mb"].as<int>();
+    }
+    if (crawl_node["robots-txt-cache-ttl"]) {
+      crawl_options->robots_txt_cache_ttl =
+          crawl_node["robots-txt-cache-ttl"].as<int>();
+    }
+    if (crawl_node["revisit-min-interval"]) {
+      crawl_options->revisit_min_interval =
+          crawl_node["revisit-min-interval"].as<int>();
+    }
+    if (crawl_node["revisit-max-interval"]) {
+      crawl_options->revisit_max_interval =
+          crawl_node["revisit-max-interval"].as<int>();
+    }
+    if (crawl_node["revisits-per-minute"]) {
+      crawl_options->revisits_per_minute =
+          crawl_node["revisits-per-minute"].as<int>();
+    }
+    if (crawl_node["max-body-size-kb"]) {
+      crawl_options->max_body_size_kb =
+          crawl_node["max-body-size-kb"].as<int>();
+    }
+    if (crawl_node["connect-timeout"]) {
+      crawl_options->connect_timeout = crawl_node["connect-timeout"].as<int>();
+    }
+    if (crawl_node["request-timeout"]) {
+      crawl_options->request_timeout = crawl_node["request-timeout"].as<int>();
+    }
+    if (crawl_node["low-speed-limit"]) {
+      crawl_options->low_speed_limit = crawl_node["low-speed-limit"].as<int>();
+    }
+    if (crawl_node["low-speed-time"]) {
+      crawl_options->low_speed_time = crawl_node["low-speed-time"].as<int>();
+    }
+    if (crawl_node["max-cached-connections"]) {
+      crawl_options->max_cached_connections =
+          crawl_node["max-cached-connections"].as<int>();
+    }
+    if (crawl_node["connection-max-idle"]) {
+      crawl_options->connection_max_idle =
+          crawl_node["connection-max-idle"].as<int>();
+    }
+    if (crawl_node["dns-cache-timeout"]) {
+      crawl_options->dns_cache_timeout =
+          crawl_node["dns-cache-timeout"].as<int>();
+    }
   } else {
     crawl_options = std::make_unique<CrawlOptions>();
   }
@@ -42,6 +125,33 @@ crawler::Options::Options(const YAML::Node &options_node) {
             : FTS_HTML_EXT_PATH;
     database_options =
         std::make_unique<DatabaseOptions>(db_path, fts_html_ext_path);
+    if (db_node["batch-size"]) {
+      database_options->batch_size = db_node["batch-size"].as<int>();
+    }
+    if (db_node["batch-interval-ms"]) {
+      database_options->batch_interval_ms =
+          db_node["batch-interval-ms"].as<int>();
+    }
+    if (db_node["queue-capacity"]) {
+      database_options->queue_capacity = db_node["queue-capacity"].as<int>();
+    }
+    if (db_node["compression-level"]) {
+      database_options->compression_level =
+          db_node["compression-level"].as<int>();
+    }
+    if (db_node["dictionary-sample-pages"]) {
+      database_options->dictionary_sample_pages =
+          db_node["dictionary-sample-pages"].as<int>();
+    }
+    if (db_node["synchronous"]) {
+      database_options->synchronous = db_node["synchronous"].as<std::string>();
+    }
+    if (db_node["cache-size-kb"]) {
+      database_options->cache_size_kb = db_node["cache-size-kb"].as<int>();
+    }
+    if (db_node["mmap-size-mb"]) {
+      database_options->mmap_size_mb = db_node["mmap-size-mb"].as<int>();
+    }
   } else {
     database_options = std::make_unique<DatabaseOptions>();
   }
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "revisit_scheduler.hpp"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "url_fingerprint_set.hpp"
+#include "utils.hpp"
+
+namespace crawler {
+
+namespace {
+
+// A page that has never been revisited is assumed to change about once over
+// this time, so its first revisit comes a day after it was found.
+constexpr std::int64_t kPriorObservedSeconds = 24 * 60 * 60;
+
+std::int64_t getUnixTime() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::optional<std::string> getOptionalText(sqlite3_stmt *stmt, int column) {
+  if (sqlite3_column_type(stmt, column) == SQLITE_NULL) {
+    return std::nullopt;
+  }
+  return std::string(
+      reinterpret_cast<const char *>(sqlite3_column_text(stmt, column)),
+      static_cast<std::size_t>(sqlite3_column_bytes(stmt, column)));
+}
+
+} // namespace
+
+RevisitScheduler::RevisitScheduler(const std::string &db_path,
+                                   const CrawlOptions &crawl_options)
+    : is_enabled(crawl_options.revisits_per_minute > 0),
+      min_interval(std::max(crawl_options.revisit_min_interval, 0)),
+      max_interval(std::max(crawl_options.revisit_max_interval,
+                            crawl_options.revisit_min_interval)),
+      revisits_per_minute(crawl_options.revisits_per_minute),
+      available_revisits(revisits_per_minute),
+      last_refill_time(std::chrono::steady_clock::now()) {
+  if (!is_enabled) {
+    return;
+  }
+
+  // The index writer owns the database; this connection only reads it
+  sqlite3 *raw_db_handle = nullptr;
+  if (sqlite3_open_v2(db_path.c_str(), &raw_db_handle, SQLITE_OPEN_READONLY,
+                      nullptr) != SQLITE_OK) {
+    std::string error_msg = sqlite3_errmsg(raw_db_handle);
+    sqlite3_close(raw_db_handle);
+    throw std::runtime_error("Failed to open SQLite database: " + error_msg);
+  }
+  db.reset(raw_db_handle);
+  sqlite3_busy_timeout(db.get(), 5000);
+
+  sqlite3_stmt *raw_stmt = nullptr;
+  if (sqlite3_prepare_v2(db.get(),
+                         "SELECT url, etag, last_modified, content_hash, "
+                         "fetched_at, next_fetch_at, change_count, "
+                         "observed_seconds FROM crawl_pages "
+                         "WHERE fingerprint = ?;",
+                         -1, &raw_stmt, nullptr) != SQLITE_OK) {
+    std::string error_msg = sqlite3_errmsg(db.get());
+    throw std::runtime_error("Failed to prepare SQLite statement: " +
+                             error_msg);
+  }
+  select_page_stmt.reset(raw_stmt);
+
+  loadSchedule();
+}
+
+std::vector<std::string> RevisitScheduler::TakeDueRevisits() {
+  std::vector<std::string> due_links;
+  if (!is_enabled) {
+    return due_links;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - last_refill_time;
+  available_revisits =
+      std::min(available_revisits + elapsed.count() * revisits_per_minute / 60,
+               revisits_per_minute);
+  last_refill_time = now;
+
+  std::int64_t now_seconds = getUnixTime();
+  std::vector<std::uint64_t> unwritten_pages;
+  while (!page_schedule.empty() && page_schedule.top().first <= now_seconds &&
+         available_revisits >= 1) {
+    std::uint64_t fingerprint = page_schedule.top().second;
+    page_schedule.pop();
+
+    std::optional<PageFetchRecord> page = loadPage(fingerprint);
+    if (!page.has_value()) {
+      // Its first fetch has not been committed yet
+      unwritten_pages.push_back(fingerprint);
+      continue;
+    }
+
+    available_revisits -= 1;
+    due_links.push_back(page->url);
+    revisits_in_flight.emplace(fingerprint, std::move(*page));
+  }
+
+  for (std::uint64_t fingerprint : unwritten_pages) {
+    page_schedule.emplace(now_seconds + min_interval.count(), fingerprint);
+  }
+  return due_links;
+}
+
+bool RevisitScheduler::HasDueRevisits() const {
+  return is_enabled && !page_schedule.empty() &&
+         page_schedule.top().first <= getUnixTime();
+}
+
+void RevisitScheduler::DropRevisit(std::string_view link) {
+  revisits_in_flight.erase(UrlFingerprintSet::Fingerprint(link));
+}
+
+void RevisitScheduler::AddValidators(FetchRequest &request) const {
+  if (request.kind != FetchKind::Page) {
+    return;
+  }
+  auto it = revisits_in_flight.find(
+      UrlFingerprintSet::Fingerprint(request.url.href));
+  if (it != revisits_in_flight.end()) {
+    request.validators = it->second.validators;
+  }
+}
+
+bool RevisitScheduler::HandleFetch(const FetchResult &fetch_result) {
+  std::int64_t now = getUnixTime();
+  bool is_fetched = fetch_result.http_code == 200 &&
+                    fetch_result.page.has_value() &&
+                    fetch_result.page->content.has_value();
+  std::uint64_t content_hash =
+      is_fetched ? utils::Hash128(*fetch_result.page->content).first : 0;
+
+  auto revisit = revisits_in_flight.extract(
+      UrlFingerprintSet::Fingerprint(fetch_result.url.href));
+  if (revisit.empty()) {
+    if (!is_fetched) {
+      return false;
+    }
+    schedulePage({.url = fetch_result.url.href,
+                  .validators = fetch_result.validators,
+                  .content_hash = content_hash,
+                  .fetched_at = now,
+                  .next_fetch_at = 0,
+                  .change_count = 0,
+                  .observed_seconds = 0},
+                 now);
+    return true;
+  }
+
+  // A failed revisit leaves the history as it is, and is tried again after
+  // the page's usual interval
+  PageFetchRecord &page = revisit.mapped();
+  bool is_changed = false;
+  if (is_fetched || fetch_result.http_code == 304) {
+    if (is_fetched) {
+      is_changed = content_hash != page.content_hash;
+      page.content_hash = content_hash;
+      page.validators = fetch_result.validators;
+    } else {
+      // A 304 only repeats the validators that changed, if any
+      if (fetch_result.validators.etag.has_value()) {
+        page.validators.etag = fetch_result.validators.etag;
+      }
+      if (fetch_result.validators.last_modified.has_value()) {
+        page.validators.last_modified = fetch_result.validators.last_modified;
+      }
+    }
+    page.observed_seconds += std::max<std::int64_t>(now - page.fetched_at, 0);
+    page.change_count += is_changed ? 1 : 0;
+    page.fetched_at = now;
+  }
+
+  schedulePage(std::move(page), now);
+  return is_changed;
+}
+
+std::vector<PageFetchRecord> RevisitScheduler::TakeFetchedPages() {
+  return std::exchange(fetched_pages, {});
+}
+
+// Private methods
+
+void RevisitScheduler::loadSchedule() {
+  sqlite3_stmt *raw_stmt = nullptr;
+  if (sqlite3_prepare_v2(db.get(),
+                         "SELECT fingerprint, next_fetch_at FROM crawl_pages;",
+                         -1, &raw_stmt, nullptr) != SQLITE_OK) {
+    std::string error_msg = sqlite3_errmsg(db.get());
+    throw std::runtime_error("Failed to prepare SQLite statement: " +
+                             error_msg);
+  }
+  std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> stmt(raw_stmt);
+
+  std::vector<ScheduledPage> pages;
+  while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+    pages.emplace_back(
+        sqlite3_column_int64(stmt.get(), 1),
+        static_cast<std::uint64_t>(sqlite3_column_int64(stmt.get(), 0)));
+  }
+  // Built in one go, which is linear instead of n log n
+  page_schedule = decltype(page_schedule)(std::greater<ScheduledPage>(),
+                                          std::move(pages));
+
+  if (!page_schedule.empty()) {
+    std::cout << "Scheduled " << page_schedule.size()
+              << " fetched pages for revisits" << std::endl;
+  }
+}
+
+std::optional<PageFetchRecord>
+RevisitScheduler::loadPage(std::uint64_t fingerprint) {
+  sqlite3_stmt *stmt = select_page_stmt.get();
+  sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(fingerprint));
+
+  std::optional<PageFetchRecord> page;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    page = PageFetchRecord{
+        .url = getOptionalText(stmt, 0).value_or(""),
+        .validators = {.etag = getOptionalText(stmt, 1),
+                       .last_modified = getOptionalText(stmt, 2)},
+        .content_hash =
+            static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 3)),
+        .fetched_at = sqlite3_column_int64(stmt, 4),
+        .next_fetch_at = sqlite3_column_int64(stmt, 5),
+        .change_count = sqlite3_column_int64(stmt, 6),
+        .observed_seconds = sqlite3_column_int64(stmt, 7)};
+  }
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return page;
+}
+
+std::chrono::seconds
+RevisitScheduler::getRevisitInterval(const PageFetchRecord &page) const {
+  // The expected time between two changes, (observed time) / (changes seen),
+  // smoothed by the prior so that a few visits do not swing it to the bounds
+  std::int64_t expected_change_interval =
+      (page.observed_seconds + kPriorObservedSeconds) / (page.change_count + 1);
+  return std::clamp(std::chrono::seconds(expected_change_interval),
+                    min_interval, max_interval);
+}
+
+void RevisitScheduler::schedulePage(PageFetchRecord page, std::int64_t now) {
+  page.next_fetch_at = now + getRevisitInterval(page).count();
+  if (is_enabled) {
+    page_schedule.emplace(page.next_fetch_at,
+                          UrlFingerprintSet::Fingerprint(page.url));
+  }
+  fetched_pages.push_back(std::move(page));
+}
+
+} // namespace crawler
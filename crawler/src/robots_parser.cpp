@@ -10,15 +10,154 @@
 
 namespace crawler {
 
+void PathRules::AddPattern(std::string_view pattern, bool is_allow) {
+  bool is_anchored = pattern.ends_with('$');
+  if (is_anchored) {
+    pattern.remove_suffix(1);
+  }
+
+  std::uint32_t node = 0;
+  for (char c : pattern) {
+    auto [it, is_new] = pending_children[node].try_emplace(
+        c, static_cast<std::uint32_t>(nodes.size()));
+    if (is_new) {
+      Node &child = nodes.emplace_back();
+      child.length = nodes[node].length + 1;
+      child.flags = c == '*' ? kWildcard : 0;
+      pending_children.emplace_back();
+    }
+    node = it->second;
+  }
+
+  if (is_anchored) {
+    nodes[node].flags |= is_allow ? kAllowExact : kDisallowExact;
+  } else {
+    nodes[node].flags |= is_allow ? kAllowPrefix : kDisallowPrefix;
+  }
+}
+
+void PathRules::Compile() {
+  // Lay out the children of every node contiguously, in label order. The
+  // '*' child is kept apart, as it matches any label.
+  edges.clear();
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i].first_edge = static_cast<std::uint32_t>(edges.size());
+    for (const auto &[label, child] : pending_children[i]) {
+      if (label == '*') {
+        nodes[i].wildcard_child = child;
+      } else {
+        edges.push_back(Edge{.label = label, .child = child});
+      }
+    }
+    nodes[i].edge_count =
+        static_cast<std::uint32_t>(edges.size()) - nodes[i].first_edge;
+  }
+  pending_children.clear();
+  pending_children.shrink_to_fit();
+
+  current_nodes.reserve(nodes.size());
+  next_nodes.reserve(nodes.size());
+  added_steps.assign(nodes.size(), 0);
+}
+
+bool PathRules::IsAllowed(std::string_view path) const {
+  // Length of the most specific match so far. A pattern's length counts the
+  // '$' it was written with.
+  std::size_t best_length = 0;
+  bool is_allowed = true;
+
+  auto record = [&](std::size_t length, bool is_allow) {
+    if (length > best_length || (length == best_length && is_allow)) {
+      best_length = length;
+      is_allowed = is_allow;
+    }
+  };
+  // Patterns match as soon as they end; anchored ones only at the end of
+  // the path
+  auto recordMatches = [&](bool is_at_end) {
+    for (std::uint32_t index : current_nodes) {
+      const Node &node = nodes[index];
+      if (node.flags & kAllowPrefix) {
+        record(node.length, true);
+      }
+      if (node.flags & kDisallowPrefix) {
+        record(node.length, false);
+      }
+      if (is_at_end && (node.flags & kAllowExact)) {
+        record(node.length + 1, true);
+      }
+      if (is_at_end && (node.flags & kDisallowExact)) {
+        record(node.length + 1, false);
+      }
+    }
+  };
+
+  nextStep();
+  current_nodes.clear();
+  addNode(0, current_nodes);
+  recordMatches(path.empty());
+
+  for (std::size_t i = 0; i < path.size() && !current_nodes.empty(); ++i) {
+    nextStep();
+    next_nodes.clear();
+    for (std::uint32_t index : current_nodes) {
+      const Node &node = nodes[index];
+      if (node.flags & kWildcard) {
+        addNode(index, next_nodes);
+      }
+      if (const Node *child = findChild(node, path[i])) {
+        addNode(static_cast<std::uint32_t>(child - nodes.data()), next_nodes);
+      }
+    }
+    current_nodes.swap(next_nodes);
+    recordMatches(i + 1 == path.size());
+  }
+
+  return is_allowed;
+}
+
+const PathRules::Node *PathRules::findChild(const Node &node,
+                                            char label) const {
+  auto first = edges.begin() + node.first_edge;
+  auto last = first + node.edge_count;
+  auto it = std::lower_bound(
+      first, last, label,
+      [](const Edge &edge, char value) { return edge.label < value; });
+  if (it == last || it->label != label) {
+    return nullptr;
+  }
+  return &nodes[it->child];
+}
+
+void PathRules::addNode(std::uint32_t node,
+                        std::vector<std::uint32_t> &node_set) const {
+  while (node != kNoNode && added_steps[node] != step) {
+    added_steps[node] = step;
+    node_set.push_back(node);
+    node = nodes[node].wildcard_child;
+  }
+}
+
+void PathRules::nextStep() const {
+  if (++step == 0) {
+    // Wrapped around: no node may look added in the new step
+    std::fill(added_steps.begin(), added_steps.end(), 0);
+    step = 1;
+  }
+}
+
 // Default constructor: results in an empty `rules` map, leading to an "allow
 // all" policy.
 RobotsParser::RobotsParser() = default;
 
 // Constructor that parses file content.
-RobotsParser::RobotsParser(const std::string &content) {
+RobotsParser::RobotsParser(const std::string &content,
+                           const std::string &user_agent) {
   std::stringstream stream(content);
   std::string line;
   std::vector<std::string> current_agents;
+  // Consecutive user-agent lines form a single group.
+  bool is_reading_agents = false;
 
   while (std::getline(stream, line)) {
     // Remove comments
@@ -34,21 +173,32 @@ RobotsParser::RobotsParser(const std::string &content) {
 
     std::string key = utils::NormalizeKey(line.substr(0, colon_pos));
     std::string value = utils::TrimValue(line.substr(colon_pos + 1));
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t' ||
+                              value.back() == '\r')) {
+      value.pop_back();
+    }
 
     if (key.empty() || value.empty()) {
       continue;
     }
 
     if (key == "user-agent") {
-      current_agents.clear();
+      if (!is_reading_agents) {
+        current_agents.clear();
+      }
       current_agents.push_back(normalizeUserAgent(value));
-    } else if (key == "allow") {
+      is_reading_agents = true;
+      continue;
+    }
+    is_reading_agents = false;
+
+    if (key == "allow") {
       for (const auto &agent : current_agents) {
-        rules[agent].allow_patterns.push_back(value);
+        rules[agent].path_rules.AddPattern(value, true);
       }
     } else if (key == "disallow") {
       for (const auto &agent : current_agents) {
-        rules[agent].disallow_patterns.push_back(value);
+        rules[agent].path_rules.AddPattern(value, false);
       }
     } else if (key == "crawl-delay") {
       int delay = 0;
@@ -61,6 +211,11 @@ RobotsParser::RobotsParser(const std::string &content) {
       }
     }
   }
+
+  for (auto &[agent, group] : rules) {
+    group.path_rules.Compile();
+  }
+  agent_rules = findRulesForAgent(user_agent);
 }
 
 // Normalizes a user-agent string: converts to lowercase and removes version
@@ -91,42 +246,16 @@ RobotsParser::findRulesForAgent(const std::string &user_agent) const {
   return nullptr; // No applicable rules
 }
 
-bool RobotsParser::IsAllowed(const std::string &path,
-                             const std::string &user_agent) const {
-  const RuleGroup *group = findRulesForAgent(user_agent);
-  if (!group) {
+bool RobotsParser::IsAllowed(std::string_view path) const {
+  if (!agent_rules) {
     return true; // If no rules apply, everything is allowed by default.
   }
-
-  size_t longest_disallow_match = 0;
-  for (const auto &pattern : group->disallow_patterns) {
-    if (path.rfind(pattern, 0) == 0) { // Check if path starts with pattern
-      if (pattern.length() > longest_disallow_match) {
-        longest_disallow_match = pattern.length();
-      }
-    }
-  }
-
-  size_t longest_allow_match = 0;
-  for (const auto &pattern : group->allow_patterns) {
-    if (path.rfind(pattern, 0) == 0) {
-      if (pattern.length() > longest_allow_match) {
-        longest_allow_match = pattern.length();
-      }
-    }
-  }
-
-  // If a disallow rule is more specific, disallow.
-  // Otherwise, it's allowed (either by a more specific allow rule or by
-  // default).
-  return longest_allow_match >= longest_disallow_match;
+  return agent_rules->path_rules.IsAllowed(path);
 }
 
-std::optional<int>
-RobotsParser::GetCrawlDelay(const std::string &user_agent) const {
-  const RuleGroup *group = findRulesForAgent(user_agent);
-  if (group && group->crawl_delay.has_value()) {
-    return group->crawl_delay;
+std::optional<int> RobotsParser::GetCrawlDelay() const {
+  if (agent_rules && agent_rules->crawl_delay.has_value()) {
+    return agent_rules->crawl_delay;
   }
   return std::nullopt;
 }
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "url.hpp"
+
+namespace crawler {
+
+HostId HostTable::Intern(std::string_view host) {
+  if (auto it = host_ids.find(host); it != host_ids.end()) {
+    return it->second;
+  }
+
+  auto host_id = static_cast<HostId>(hosts.size());
+  hosts.emplace_back(host);
+  host_ids.emplace(hosts.back(), host_id);
+  return host_id;
+}
+
+const std::string &HostTable::GetHost(HostId host_id) const {
+  return hosts.at(host_id);
+}
+
+std::string_view NormalizedUrl::GetPath() const {
+  return std::string_view(href).substr(path_offset);
+}
+
+std::string_view NormalizedUrl::GetOrigin() const {
+  return std::string_view(href).substr(0, path_offset);
+}
+
+std::optional<NormalizedUrl> ParseUrl(std::string_view link,
+                                      const ada::url_aggregator *base_url,
+                                      HostTable &host_table) {
+  auto url = ada::parse<ada::url_aggregator>(link, base_url);
+  if (!url) {
+    return std::nullopt;
+  }
+
+  std::string_view protocol = url->get_protocol();
+  if ((protocol != "http:" && protocol != "https:") ||
+      url->has_credentials()) {
+    return std::nullopt;
+  }
+
+  // Fragments never reach the server, drop them so "page#a" and "page#b" are
+  // the same link.
+  url->set_hash("");
+
+  std::string_view href = url->get_href();
+  std::size_t path_length =
+      url->get_pathname().size() + url->get_search().size();
+
+  return NormalizedUrl{
+      .href = std::string(href),
+      .host_id = host_table.Intern(url->get_host()),
+      .path_offset = static_cast<std::uint32_t>(href.size() - path_length)};
+}
+
+} // namespace crawler
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "url_fingerprint_set.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+
+#include "utils.hpp"
+
+namespace crawler {
+
+namespace {
+
+constexpr std::size_t kInitialSlotCount = 1024;
+
+} // namespace
+
+UrlFingerprintSet::UrlFingerprintSet(std::size_t memory_limit_bytes)
+    : size(0), rejected_count(0) {
+  // Capacity is a power of two so probing can mask instead of divide. The
+  // table doubles into a new one while the old one is still alive, so the
+  // last growth, to max_slot_count, takes one and a half times its memory.
+  std::size_t slot_limit = memory_limit_bytes / sizeof(std::uint64_t) / 3 * 2;
+  max_slot_count =
+      std::max(kInitialSlotCount, std::bit_floor(std::max<std::size_t>(
+                                      slot_limit, 1)));
+  slots.assign(std::min(kInitialSlotCount, max_slot_count), kEmptySlot);
+}
+
+bool UrlFingerprintSet::Insert(std::string_view url) {
+  return InsertFingerprint(Fingerprint(url));
+}
+
+bool UrlFingerprintSet::InsertFingerprint(std::uint64_t fingerprint) {
+  if (fingerprint == kEmptySlot) {
+    fingerprint = 1; // As remapped by Fingerprint()
+  }
+  std::size_t slot = findSlot(fingerprint);
+  if (slots[slot] == fingerprint) {
+    return false;
+  }
+
+  if (isAtLoadLimit()) {
+    if (slots.size() >= max_slot_count) {
+      if (rejected_count++ == 0) {
+        std::cerr << "Known link set is full at " << size
+                  << " links, false positive rate " << GetFalsePositiveRate()
+                  << ", new links are being dropped" << std::endl;
+      }
+      return false;
+    }
+    grow();
+    slot = findSlot(fingerprint);
+  }
+
+  slots[slot] = fingerprint;
+  ++size;
+  return true;
+}
+
+bool UrlFingerprintSet::Contains(std::string_view url) const {
+  std::uint64_t fingerprint = Fingerprint(url);
+  return slots[findSlot(fingerprint)] == fingerprint;
+}
+
+std::size_t UrlFingerprintSet::Size() const { return size; }
+
+std::size_t UrlFingerprintSet::GetMemoryUsage() const {
+  return slots.size() * sizeof(std::uint64_t);
+}
+
+std::size_t UrlFingerprintSet::GetRejectedCount() const {
+  return rejected_count;
+}
+
+double UrlFingerprintSet::GetFalsePositiveRate() const {
+  // A new URL is a false positive if its fingerprint equals any of the `size`
+  // stored ones.
+  return static_cast<double>(size) / 18446744073709551616.0; // 2^64
+}
+
+std::uint64_t UrlFingerprintSet::Fingerprint(std::string_view url) {
+  std::uint64_t fingerprint = utils::Hash128(url).first;
+  return fingerprint == kEmptySlot ? 1 : fingerprint;
+}
+
+// Private methods
+
+std::size_t UrlFingerprintSet::findSlot(std::uint64_t fingerprint) const {
+  // Linear probing; the table is never completely full, so this terminates
+  // at either the fingerprint or an empty slot.
+  std::size_t mask = slots.size() - 1;
+  std::size_t slot = fingerprint & mask;
+  while (slots[slot] != kEmptySlot && slots[slot] != fingerprint) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+bool UrlFingerprintSet::isAtLoadLimit() const {
+  // Grow at 3/4 full. At the memory limit the table is allowed to reach 7/8
+  // full instead, trading probe length for capacity: looking up a new link,
+  // which most discovered links are, takes about (1 + 1 / (1 - load)^2) / 2
+  // probes, 8.5 at 3/4 and 32.5 at 7/8 (but 128.5 at 15/16).
+  if (slots.size() < max_slot_count) {
+    return size + 1 > slots.size() / 4 * 3;
+  }
+  return size + 1 > slots.size() / 8 * 7;
+}
+
+void UrlFingerprintSet::grow() {
+  std::vector<std::uint64_t> old_slots(slots.size() * 2, kEmptySlot);
+  old_slots.swap(slots);
+
+  for (std::uint64_t fingerprint : old_slots) {
+    if (fingerprint != kEmptySlot) {
+      slots[findSlot(fingerprint)] = fingerprint;
+    }
+  }
+
+  std::cout << "Known link set grown to " << slots.size() << " slots ("
+            << GetMemoryUsage() / (1024 * 1024) << " MiB) for " << size
+            << " links, false positive rate " << GetFalsePositiveRate()
+            << std::endl;
+}
+
+} // namespace crawler
@@ -2,9 +2,9 @@
 #include "utils.hpp"
 
 #include <algorithm>
-#include <iostream>
-
-#include "config.hpp"
+#include <bit>
+#include <charconv>
+#include <cstring>
 
 namespace utils {
 
@@ -28,34 +28,212 @@ std::string TrimValue(const std::string &s) {
   return s.substr(start);
 }
 
-std::string GetHostFromUrl(const std::string &url_string) {
-  auto url = ada::parse(url_string);
-  if (!url) {
-    std::cerr << "Invalid URL: " << url_string << std::endl;
-    return "";
+std::string_view TrimWhitespace(std::string_view s) {
+  size_t start = s.find_first_not_of(" \t\n\r\f");
+  if (std::string_view::npos == start) {
+    return {};
   }
+  size_t end = s.find_last_not_of(" \t\n\r\f");
+  return s.substr(start, end - start + 1);
+}
 
-  return std::string(url->get_host());
+static void appendUtf8(std::string &target, unsigned int code_point) {
+  if (code_point < 0x80) {
+    target.push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    target.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    target.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    target.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x110000) {
+    target.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    target.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    target.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
 }
 
-std::string GetBaseUrl(const std::string &url_string) {
-  auto url = ada::parse(url_string);
-  if (!url) {
-    std::cerr << "Invalid URL: " << url_string << std::endl;
-    return "";
+std::string DecodeHtmlEntities(std::string_view text) {
+  std::string decoded;
+  decoded.reserve(text.size());
+
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t amp = text.find('&', pos);
+    if (amp == std::string_view::npos) {
+      decoded.append(text.substr(pos));
+      break;
+    }
+    decoded.append(text.substr(pos, amp - pos));
+
+    size_t semicolon = text.find(';', amp);
+    if (semicolon == std::string_view::npos || semicolon - amp > 10) {
+      decoded.push_back('&');
+      pos = amp + 1;
+      continue;
+    }
+
+    std::string_view entity = text.substr(amp + 1, semicolon - amp - 1);
+    if (entity == "amp") {
+      decoded.push_back('&');
+    } else if (entity == "lt") {
+      decoded.push_back('<');
+    } else if (entity == "gt") {
+      decoded.push_back('>');
+    } else if (entity == "quot") {
+      decoded.push_back('"');
+    } else if (entity == "apos") {
+      decoded.push_back('\'');
+    } else if (entity == "nbsp") {
+      decoded.push_back(' ');
+    } else if (entity.size() > 1 && entity[0] == '#') {
+      bool is_hex = entity[1] == 'x' || entity[1] == 'X';
+      std::string_view digits = entity.substr(is_hex ? 2 : 1);
+      unsigned int code_point = 0;
+      auto [ptr, ec] =
+          std::from_chars(digits.data(), digits.data() + digits.size(),
+                          code_point, is_hex ? 16 : 10);
+      if (ec != std::errc() || ptr != digits.data() + digits.size()) {
+        decoded.append(text.substr(amp, semicolon - amp + 1));
+      } else {
+        appendUtf8(decoded, code_point);
+      }
+    } else {
+      decoded.append(text.substr(amp, semicolon - amp + 1));
+    }
+    pos = semicolon + 1;
   }
 
-  return std::string(url->get_origin());
+  return decoded;
 }
 
-std::string GetPathFromUrl(const std::string &url_string) {
-  auto url = ada::parse(url_string);
-  if (!url) {
-    std::cerr << "Invalid URL: " << url_string << std::endl;
-    return "";
+std::string EscapeHtmlText(std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (char c : text) {
+    if (c == '&') {
+      escaped.append("&amp;");
+    } else if (c == '<') {
+      escaped.append("&lt;");
+    } else {
+      escaped.push_back(c);
+    }
   }
+  return escaped;
+}
+
+static std::uint64_t fmix64(std::uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+std::pair<std::uint64_t, std::uint64_t> Hash128(std::string_view data) {
+  constexpr std::uint64_t c1 = 0x87c37b91114253d5ULL;
+  constexpr std::uint64_t c2 = 0x4cf5ad432745937fULL;
+  const std::size_t block_count = data.size() / 16;
+
+  std::uint64_t h1 = 0;
+  std::uint64_t h2 = 0;
+
+  for (std::size_t i = 0; i < block_count; ++i) {
+    std::uint64_t k1;
+    std::uint64_t k2;
+    std::memcpy(&k1, data.data() + i * 16, sizeof(k1));
+    std::memcpy(&k2, data.data() + i * 16 + 8, sizeof(k2));
+
+    k1 *= c1;
+    k1 = std::rotl(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = std::rotl(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = std::rotl(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = std::rotl(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  // Tail: the last 0-15 bytes
+  const auto *tail =
+      reinterpret_cast<const unsigned char *>(data.data() + block_count * 16);
+  std::uint64_t k1 = 0;
+  std::uint64_t k2 = 0;
+  switch (data.size() & 15) {
+  case 15:
+    k2 ^= static_cast<std::uint64_t>(tail[14]) << 48;
+    [[fallthrough]];
+  case 14:
+    k2 ^= static_cast<std::uint64_t>(tail[13]) << 40;
+    [[fallthrough]];
+  case 13:
+    k2 ^= static_cast<std::uint64_t>(tail[12]) << 32;
+    [[fallthrough]];
+  case 12:
+    k2 ^= static_cast<std::uint64_t>(tail[11]) << 24;
+    [[fallthrough]];
+  case 11:
+    k2 ^= static_cast<std::uint64_t>(tail[10]) << 16;
+    [[fallthrough]];
+  case 10:
+    k2 ^= static_cast<std::uint64_t>(tail[9]) << 8;
+    [[fallthrough]];
+  case 9:
+    k2 ^= static_cast<std::uint64_t>(tail[8]);
+    k2 *= c2;
+    k2 = std::rotl(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    [[fallthrough]];
+  case 8:
+    k1 ^= static_cast<std::uint64_t>(tail[7]) << 56;
+    [[fallthrough]];
+  case 7:
+    k1 ^= static_cast<std::uint64_t>(tail[6]) << 48;
+    [[fallthrough]];
+  case 6:
+    k1 ^= static_cast<std::uint64_t>(tail[5]) << 40;
+    [[fallthrough]];
+  case 5:
+    k1 ^= static_cast<std::uint64_t>(tail[4]) << 32;
+    [[fallthrough]];
+  case 4:
+    k1 ^= static_cast<std::uint64_t>(tail[3]) << 24;
+    [[fallthrough]];
+  case 3:
+    k1 ^= static_cast<std::uint64_t>(tail[2]) << 16;
+    [[fallthrough]];
+  case 2:
+    k1 ^= static_cast<std::uint64_t>(tail[1]) << 8;
+    [[fallthrough]];
+  case 1:
+    k1 ^= static_cast<std::uint64_t>(tail[0]);
+    k1 *= c1;
+    k1 = std::rotl(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= data.size();
+  h2 ^= data.size();
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
 
-  return std::string(url->get_pathname());
+  return {h1, h2};
 }
 
 } // namespace utils
\ No newline at end of file
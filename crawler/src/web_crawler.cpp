@@ -3,19 +3,81 @@
 
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <curl/header.h>
+#include <curl/multi.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <string>
 
+#include "utils.hpp"
+
 namespace crawler {
 
+namespace {
+
+// Initial capacity of a transfer's body buffer, enough for most pages to
+// arrive without the buffer being regrown.
+constexpr std::size_t kInitialBodyCapacity = 64 * 1024;
+
+// Largest body of a response that is not indexed (an error page, a
+// redirect) that is read past rather than ending the transfer, which would
+// close its connection.
+constexpr std::size_t kMaxDiscardedBodySize = 16 * 1024;
+
+// Sent as Accept-Encoding, it asks for every encoding this libcurl can
+// decode (gzip and deflate, br and zstd when built with them), and has the
+// body decoded as it streams in.
+constexpr const char *kAcceptEveryEncoding = "";
+
+} // namespace
+
+std::string_view PageResult::GetText(const TextSpan &span) const {
+  if (!content.has_value() || span.offset > content->size()) {
+    return {};
+  }
+  return std::string_view(*content).substr(span.offset, span.length);
+}
+
 void CURLDeleter::operator()(CURL *curl) const {
   if (curl) {
     curl_easy_cleanup(curl);
   }
 }
 
-WebCrawler::WebCrawler() {
+void CURLMDeleter::operator()(CURLM *multi) const {
+  if (multi) {
+    curl_multi_cleanup(multi);
+  }
+}
+
+void CURLSHDeleter::operator()(CURLSH *share) const {
+  if (share) {
+    curl_share_cleanup(share);
+  }
+}
+
+void CURLSlistDeleter::operator()(curl_slist *list) const {
+  if (list) {
+    curl_slist_free_all(list);
+  }
+}
+
+WebCrawler::WebCrawler() : WebCrawler(CrawlOptions()) {}
+
+WebCrawler::WebCrawler(const CrawlOptions &crawl_options)
+    : connect_timeout(crawl_options.connect_timeout),
+      request_timeout(crawl_options.request_timeout),
+      low_speed_limit(crawl_options.low_speed_limit),
+      low_speed_time(crawl_options.low_speed_time),
+      dns_cache_timeout(crawl_options.dns_cache_timeout),
+      connection_max_idle(crawl_options.connection_max_idle),
+      max_cached_connections(static_cast<std::size_t>(
+          std::max(crawl_options.max_cached_connections, 1))) {
   if (!is_curl_global_init) {
     if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
       std::cerr << "curl_global_init() failed" << std::endl;
@@ -24,100 +86,394 @@ WebCrawler::WebCrawler() {
     is_curl_global_init = true;
   }
 
-  CURL *handle = curl_easy_init();
-  if (!handle) {
-    std::cerr << "curl_easy_init() failed" << std::endl;
-    throw std::runtime_error("Failed to initialize cURL handle");
+  // Transfers all run on this thread, so the share needs no locking
+  CURLSH *share_handle = curl_share_init();
+  if (!share_handle) {
+    std::cerr << "curl_share_init() failed" << std::endl;
+    throw std::runtime_error("Failed to initialize cURL share handle");
+  }
+  share.reset(share_handle);
+  curl_share_setopt(share.get(), CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share.get(), CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+  CURLM *multi_handle = curl_multi_init();
+  if (!multi_handle) {
+    std::cerr << "curl_multi_init() failed" << std::endl;
+    throw std::runtime_error("Failed to initialize cURL multi handle");
+  }
+  multi.reset(multi_handle);
+  // Requests to a host that speaks HTTP/2 go over the connection already
+  // open to it, instead of opening another one
+  curl_multi_setopt(multi.get(), CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(multi.get(), CURLMOPT_MAXCONNECTS,
+                    static_cast<long>(max_cached_connections));
+
+  // Transfers are heap allocated so the buffers handed to cURL never move.
+  for (int i = 0; i < crawl_options.max_concurrent_requests; ++i) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->max_body_size =
+        static_cast<std::size_t>(std::max(crawl_options.max_body_size_kb, 0)) *
+        1024;
+    transfer->handle.reset(curl_easy_init());
+    if (!transfer->handle) {
+      std::cerr << "curl_easy_init() failed" << std::endl;
+      throw std::runtime_error("Failed to initialize cURL handle");
+    }
+    curl_easy_setopt(transfer->handle.get(), CURLOPT_SHARE, share.get());
+    transfers.push_back(std::move(transfer));
+  }
+}
+
+WebCrawler::~WebCrawler() {
+  // Easy handles must be detached before the multi handle is cleaned up.
+  for (const auto &transfer : transfers) {
+    if (transfer->busy) {
+      curl_multi_remove_handle(multi.get(), transfer->handle.get());
+    }
+  }
+}
+
+bool WebCrawler::SubmitPage(FetchRequest request) {
+  for (const auto &transfer : transfers) {
+    if (transfer->busy) {
+      continue;
+    }
+
+    transfer->url = std::move(request.url);
+    transfer->kind = request.kind;
+    // The previous body was moved into its PageResult, start a fresh one.
+    transfer->read_buffer.clear();
+    transfer->read_buffer.reserve(kInitialBodyCapacity);
+    transfer->extractor.Reset();
+    transfer->is_response_checked = false;
+    transfer->is_body_discarded = false;
+    transfer->discarded_size = 0;
+    transfer->is_truncated = false;
+    transfer->rejection.reset();
+    idle_hosts.erase(transfer->url.host_id);
+    setTransferOptions(transfer->handle.get(), transfer.get());
+    setConditionalHeaders(*transfer, request.validators);
+    curl_easy_setopt(transfer->handle.get(), CURLOPT_PRIVATE, transfer.get());
+
+    if (curl_multi_add_handle(multi.get(), transfer->handle.get()) !=
+        CURLM_OK) {
+      std::cerr << "curl_multi_add_handle() failed for: " << transfer->url.href
+                << std::endl;
+      completed_pages.push(FetchResult{.url = std::move(transfer->url),
+                                       .kind = transfer->kind,
+                                       .http_code = 0,
+                                       .page = std::nullopt});
+      return false;
+    }
+
+    transfer->busy = true;
+    ++running_transfers;
+    return true;
   }
-  curl.reset(handle);
 
-  link_regex =
-      std::regex(R"(<a\s+[^>]*href\s*=\s*(?:["']([^"']+)["']|([^\s>]+)))",
-                 std::regex::icase);
+  std::cerr << "No free transfer slot for: " << request.url.href << std::endl;
+  completed_pages.push(FetchResult{.url = std::move(request.url),
+                                   .kind = request.kind,
+                                   .http_code = 0,
+                                   .page = std::nullopt});
+  return false;
+}
+
+bool WebCrawler::HasFreeSlot() const {
+  return running_transfers < static_cast<int>(transfers.size());
+}
 
-  title_regex =
-      std::regex(R"(<title[^>]*>([\s\S]*?)<\/title>)", std::regex::icase);
+bool WebCrawler::HasPendingPages() const {
+  return running_transfers > 0 || !completed_pages.empty();
 }
 
-WebCrawler::~WebCrawler() = default;
+void WebCrawler::Perform(std::chrono::milliseconds timeout) {
+  int still_running = 0;
+  curl_multi_perform(multi.get(), &still_running);
+
+  if (still_running > 0 || running_transfers == 0) {
+    // With no transfers curl_multi_poll() simply sleeps for the timeout, which
+    // is what the caller wants while every host is cooling down.
+    curl_multi_poll(multi.get(), nullptr, 0, static_cast<int>(timeout.count()),
+                    nullptr);
+    curl_multi_perform(multi.get(), &still_running);
+  }
+
+  CURLMsg *message = nullptr;
+  int messages_left = 0;
+  while ((message = curl_multi_info_read(multi.get(), &messages_left))) {
+    if (message->msg != CURLMSG_DONE) {
+      continue;
+    }
 
-std::optional<PageResult> WebCrawler::GetPage(const std::string &url) {
-  CURLcode res;
-  std::string read_buffer;
+    Transfer *transfer = nullptr;
+    curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+    curl_multi_remove_handle(multi.get(), message->easy_handle);
 
-  // Set the URL and options that we want to fetch
-  curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 0L);
-  curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, writeCallback);
-  curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &read_buffer);
-  curl_easy_setopt(curl.get(), CURLOPT_USERAGENT,
-                   "SearchLight/0.1 (WebCrawler)");
+    FetchResult fetch_result{.url = std::move(transfer->url),
+                             .kind = transfer->kind,
+                             .http_code = 0,
+                             .page = std::nullopt};
+    curl_easy_getinfo(transfer->handle.get(), CURLINFO_RESPONSE_CODE,
+                      &fetch_result.http_code);
+    if (message->data.result == CURLE_OK || transfer->is_truncated) {
+      fetch_result.page = buildPageResult(transfer->handle.get(), *transfer);
+      if (fetch_result.http_code == 200 || fetch_result.http_code == 304) {
+        fetch_result.validators = getValidators(transfer->handle.get());
+      }
+    } else if (transfer->rejection.has_value()) {
+      std::cout << "Skipping " << fetch_result.url.href << ": "
+                << *transfer->rejection << std::endl;
+      // Do not hold on to up to a whole rejected body until the next fetch
+      transfer->read_buffer = std::string();
+    } else {
+      std::cerr << "Fetching " << fetch_result.url.href
+                << " failed: " << curl_easy_strerror(message->data.result)
+                << std::endl;
+    }
 
-  // Perform the request, res will get the return code
-  // (not the HTTP status code)
-  res = curl_easy_perform(curl.get());
+    markHostAsIdle(fetch_result.url.host_id);
+    transfer->busy = false;
+    --running_transfers;
+    completed_pages.push(std::move(fetch_result));
+  }
+}
 
-  // Check for errors
-  if (res != CURLE_OK) {
-    std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res)
-              << std::endl;
+std::optional<FetchResult> WebCrawler::PopCompletedPage() {
+  if (completed_pages.empty()) {
     return std::nullopt;
+  }
+
+  FetchResult fetch_result = std::move(completed_pages.front());
+  completed_pages.pop();
+  return fetch_result;
+}
+
+bool WebCrawler::HasWarmConnection(HostId host_id) const {
+  auto it = idle_hosts.find(host_id);
+  return it != idle_hosts.end() &&
+         std::chrono::steady_clock::now() - it->second < connection_max_idle;
+}
+
+// Private methods
+
+void WebCrawler::setTransferOptions(CURL *handle, Transfer *transfer) const {
+  // Set the URL and options that we want to fetch. Redirects of pages go
+  // back through the frontier; robots.txt redirects are followed in place,
+  // up to the five hops RFC 9309 asks crawlers to follow.
+  if (transfer->kind == FetchKind::RobotsTxt) {
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 5L);
   } else {
-    int http_code = 0;
-    curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &http_code);
-
-    if (http_code == 301 || http_code == 302) {
-      char *redirect_url = nullptr;
-      curl_easy_getinfo(curl.get(), CURLINFO_REDIRECT_URL, &redirect_url);
-      return std::make_optional(
-          PageResult{.content = std::nullopt,
-                     .title = std::nullopt,
-                     .links = {redirect_url ? redirect_url : ""}});
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 0L);
+  }
+  curl_easy_setopt(handle, CURLOPT_URL, transfer->url.href.c_str());
+  curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeCallback);
+  curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer);
+  curl_easy_setopt(handle, CURLOPT_USERAGENT, "SearchLight/0.1 (WebCrawler)");
+  curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, kAcceptEveryEncoding);
+
+  // HTTP/2 is negotiated over TLS; a transfer to a host that is being
+  // connected to waits to multiplex on that connection
+  curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+  curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, dns_cache_timeout);
+  curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN,
+                   static_cast<long>(connection_max_idle.count()));
+
+  // A host that stops answering, or trickles bytes out, must not hold a
+  // transfer slot forever
+  curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, connect_timeout);
+  curl_easy_setopt(handle, CURLOPT_TIMEOUT, request_timeout);
+  curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, low_speed_limit);
+  curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, low_speed_time);
+}
+
+void WebCrawler::setConditionalHeaders(Transfer &transfer,
+                                       const HttpValidators &validators) const {
+  // The validators are sent back exactly as the server gave them, as RFC 9110
+  // recommends for If-Modified-Since.
+  curl_slist *headers = nullptr;
+  if (validators.etag.has_value()) {
+    headers = curl_slist_append(
+        headers, ("If-None-Match: " + *validators.etag).c_str());
+  }
+  if (validators.last_modified.has_value()) {
+    headers = curl_slist_append(
+        headers, ("If-Modified-Since: " + *validators.last_modified).c_str());
+  }
+  transfer.headers.reset(headers);
+  // Also clears the headers of the handle's previous fetch
+  curl_easy_setopt(transfer.handle.get(), CURLOPT_HTTPHEADER, headers);
+}
+
+HttpValidators WebCrawler::getValidators(CURL *handle) {
+  auto getHeader = [&](const char *name) -> std::optional<std::string> {
+    curl_header *header = nullptr;
+    if (curl_easy_header(handle, name, 0, CURLH_HEADER, -1, &header) !=
+        CURLHE_OK) {
+      return std::nullopt;
     }
+    return std::string(header->value);
+  };
 
-    if (http_code == 200) {
-      PageResult result;
-      result.content = read_buffer;
-
-      std::smatch title_match;
-      if (std::regex_search(read_buffer, title_match, title_regex)) {
-        if (title_match.size() > 1) {
-          result.title = title_match[1].str();
-        }
-      } else {
-        result.title = std::nullopt;
-      }
+  return HttpValidators{.etag = getHeader("ETag"),
+                        .last_modified = getHeader("Last-Modified")};
+}
 
-      auto links_begin = std::sregex_iterator(read_buffer.begin(),
-                                              read_buffer.end(), link_regex);
-      auto links_end = std::sregex_iterator();
+void WebCrawler::markHostAsIdle(HostId host_id) {
+  auto now = std::chrono::steady_clock::now();
+  idle_hosts[host_id] = now;
 
-      for (std::sregex_iterator i = links_begin; i != links_end; ++i) {
-        std::smatch match = *i;
-        std::string link;
+  // The connection cache closes the connections idle for the longest first,
+  // so past its size only the most recent hosts are likely warm
+  if (idle_hosts.size() <= 2 * max_cached_connections) {
+    return;
+  }
+  std::vector<std::chrono::steady_clock::time_point> idle_since;
+  idle_since.reserve(idle_hosts.size());
+  for (const auto &[idle_host_id, time] : idle_hosts) {
+    idle_since.push_back(time);
+  }
+  auto newest = idle_since.begin() + (max_cached_connections - 1);
+  std::nth_element(idle_since.begin(), newest, idle_since.end(),
+                   std::greater<>());
+  std::chrono::steady_clock::time_point cutoff =
+      std::max(*newest, now - connection_max_idle);
+  std::erase_if(idle_hosts,
+                [&](const auto &idle_host) { return idle_host.second < cutoff; });
+}
 
-        if (match[1].matched) { // quoted link
-          link = match[1].str();
-        } else if (match[2].matched) { // unquoted link
-          link = match[2].str();
-        }
+std::optional<PageResult> WebCrawler::buildPageResult(CURL *handle,
+                                                      Transfer &transfer) {
+  long http_code = 0;
+  curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
 
-        if (!link.empty()) {
-          result.links.push_back(link);
-        }
-      }
+  if (transfer.kind == FetchKind::RobotsTxt) {
+    if (http_code < 200 || http_code >= 300) {
+      return std::nullopt;
+    }
+    PageResult result;
+    result.content = std::move(transfer.read_buffer);
+    return result;
+  }
 
-      return std::make_optional(result);
+  if (http_code == 301 || http_code == 302) {
+    char *redirect_url = nullptr;
+    curl_easy_getinfo(handle, CURLINFO_REDIRECT_URL, &redirect_url);
+    PageResult result;
+    if (redirect_url) {
+      result.redirect_url = redirect_url;
     }
+    return result;
   }
 
+  if (http_code == 200) {
+    // Title and links were located while the body was downloading; the body
+    // itself is handed over without a copy.
+    PageResult result;
+    result.content = std::move(transfer.read_buffer);
+    result.title = transfer.extractor.TakeTitle();
+    result.base_url = transfer.extractor.TakeBaseHref();
+    result.links = transfer.extractor.TakeLinks();
+    result.content_signature = transfer.extractor.TakeContentSignature();
+    return result;
+  }
+
+  return std::nullopt;
+}
+
+std::optional<std::string>
+WebCrawler::checkResponse(const Transfer &transfer) {
+  CURL *handle = transfer.handle.get();
+
+  // The length is that of the encoded body, which decodes to at least as
+  // much
+  curl_off_t content_length = -1;
+  curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                    &content_length);
+  if (content_length >= 0 &&
+      static_cast<std::uint64_t>(content_length) > transfer.max_body_size) {
+    return "body of " + std::to_string(content_length) +
+           " bytes is too large";
+  }
+
+  char *content_type = nullptr;
+  curl_easy_getinfo(handle, CURLINFO_CONTENT_TYPE, &content_type);
+  if (content_type && !isHtmlContentType(content_type)) {
+    return "content type " + std::string(content_type) + " is not HTML";
+  }
   return std::nullopt;
 }
 
+bool WebCrawler::isHtmlContentType(std::string_view content_type) {
+  // Only the media type matters, not its parameters
+  content_type = utils::TrimWhitespace(
+      content_type.substr(0, content_type.find(';')));
+  auto isEqual = [&](std::string_view media_type) {
+    return std::equal(content_type.begin(), content_type.end(),
+                      media_type.begin(), media_type.end(),
+                      [](char a, char b) {
+                        return std::tolower(static_cast<unsigned char>(a)) ==
+                               b;
+                      });
+  };
+  return isEqual("text/html") || isEqual("application/xhtml+xml");
+}
+
 std::size_t WebCrawler::writeCallback(void *contents, std::size_t size,
                                       std::size_t nmemb, void *userp) {
-  ((std::string *)userp)->append((char *)contents, size * nmemb);
-  return size * nmemb;
+  auto *transfer = static_cast<Transfer *>(userp);
+  std::string_view chunk(static_cast<char *>(contents), size * nmemb);
+
+  // A robots.txt is cut at the size crawlers have to parse, and the
+  // transfer ends there as a success. Returning less than the chunk aborts
+  // the transfer.
+  if (transfer->kind == FetchKind::RobotsTxt) {
+    if (transfer->read_buffer.size() + chunk.size() > kMaxRobotsTxtSize) {
+      transfer->read_buffer.append(
+          chunk.substr(0, kMaxRobotsTxtSize - transfer->read_buffer.size()));
+      transfer->is_truncated = true;
+      return 0;
+    }
+    transfer->read_buffer.append(chunk);
+    return chunk.size();
+  }
+
+  // The headers are in by the time the first bytes of the body arrive
+  if (!transfer->is_response_checked) {
+    transfer->is_response_checked = true;
+    long http_code = 0;
+    curl_easy_getinfo(transfer->handle.get(), CURLINFO_RESPONSE_CODE,
+                      &http_code);
+    transfer->is_body_discarded = http_code != 200;
+    if (!transfer->is_body_discarded) {
+      transfer->rejection = checkResponse(*transfer);
+    }
+  }
+
+  // Other responses are not indexed, so their bodies are neither kept nor
+  // parsed. A long one ends the transfer, which still completes.
+  if (transfer->is_body_discarded) {
+    transfer->discarded_size += chunk.size();
+    if (transfer->discarded_size > kMaxDiscardedBodySize) {
+      transfer->is_truncated = true;
+      return 0;
+    }
+    return chunk.size();
+  }
+  if (!transfer->rejection.has_value() &&
+      transfer->read_buffer.size() + chunk.size() > transfer->max_body_size) {
+    transfer->rejection = "body is larger than " +
+                          std::to_string(transfer->max_body_size) + " bytes";
+  }
+  if (transfer->rejection.has_value()) {
+    return 0;
+  }
+
+  transfer->read_buffer.append(chunk);
+  transfer->extractor.Feed(chunk);
+  return chunk.size();
 }
 
 } // namespace crawler
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+//
+// Compares the posting list kernels at every SIMD level the CPU supports
+// with their scalar versions, checking that they all agree.
+//
+// Usage: searchlight-kernels-bench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "bit_packing.hpp"
+#include "intersection.hpp"
+#include "simd.hpp"
+
+namespace {
+
+constexpr std::size_t kRepeatCount = 20000;
+
+std::vector<indexer::SimdLevel> getLevels() {
+  std::vector<indexer::SimdLevel> levels = {indexer::SimdLevel::kScalar};
+  for (auto level : {indexer::SimdLevel::kSse41, indexer::SimdLevel::kAvx2}) {
+    if (level <= indexer::GetSupportedSimdLevel()) {
+      levels.push_back(level);
+    }
+  }
+  return levels;
+}
+
+std::vector<std::uint32_t> sortedValues(std::mt19937 &rng, std::size_t count,
+                                        std::uint32_t max_gap) {
+  std::uniform_int_distribution<std::uint32_t> gap(1, max_gap);
+  std::vector<std::uint32_t> values(count);
+  std::uint32_t value = 0;
+  for (std::uint32_t &v : values) {
+    value += gap(rng);
+    v = value;
+  }
+  return values;
+}
+
+// Runs `kernel` at every level, and prints the time a run takes and the
+// speedup over the scalar version. `kernel` returns a checksum of its
+// results, which has to be the same at every level.
+void measure(const char *name, std::size_t repeat_count,
+             const std::function<std::uint64_t()> &kernel) {
+  std::printf("%-32s", name);
+  double scalar_time = 0.0;
+  std::uint64_t scalar_checksum = 0;
+  for (indexer::SimdLevel level : getLevels()) {
+    indexer::SetSimdLevel(level);
+    std::uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < repeat_count; ++i) {
+      checksum += kernel();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double time =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        static_cast<double>(repeat_count);
+
+    if (level == indexer::SimdLevel::kScalar) {
+      scalar_time = time;
+      scalar_checksum = checksum;
+      std::printf("  %s %9.1f ns", indexer::GetSimdLevelName(level), time);
+    } else {
+      std::printf("  %s %9.1f ns (%.2fx)%s", indexer::GetSimdLevelName(level),
+                  time, scalar_time / time,
+                  checksum == scalar_checksum ? "" : " MISMATCH");
+    }
+  }
+  std::printf("\n");
+  indexer::SetSimdLevel(indexer::SimdLevel::kAvx2);
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(42);
+  std::printf("Supported: %s\n\n",
+              indexer::GetSimdLevelName(indexer::GetSupportedSimdLevel()));
+
+  for (std::uint32_t bits : {1U, 4U, 7U, 12U, 20U, 32U}) {
+    std::uniform_int_distribution<std::uint32_t> value(
+        0, bits == 32 ? UINT32_MAX : (1U << bits) - 1);
+    std::uint32_t values[indexer::kBlockSize];
+    for (std::uint32_t &v : values) {
+      v = value(rng);
+    }
+    std::vector<std::uint32_t> packed(indexer::PackedBlockWords(bits));
+    indexer::PackBlock(values, bits, packed.data());
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "UnpackBlock, %u bits", bits);
+    measure(name, kRepeatCount * 10, [&]() {
+      indexer::UnpackBlock(packed.data(), bits, values);
+      return static_cast<std::uint64_t>(values[0]) + values[61] + values[127];
+    });
+  }
+
+  std::uniform_int_distribution<std::uint32_t> gap(0, 200);
+  std::uint32_t gaps[indexer::kBlockSize];
+  for (std::uint32_t &g : gaps) {
+    g = gap(rng);
+  }
+  measure("DecodeGaps, 128 gaps", kRepeatCount * 10, [&]() {
+    std::uint32_t docs[indexer::kBlockSize];
+    std::copy(std::begin(gaps), std::end(gaps), docs);
+    indexer::DecodeGaps(docs, indexer::kBlockSize, 1000);
+    return static_cast<std::uint64_t>(docs[17]) + docs[indexer::kBlockSize - 1];
+  });
+
+  // Advancing through a block, as the other terms of a conjunction do
+  for (std::uint32_t jump : {2U, 16U, 64U}) {
+    std::vector<std::uint32_t> block =
+        sortedValues(rng, indexer::kBlockSize, 8);
+    char name[64];
+    std::snprintf(name, sizeof(name), "LowerBound in block, jump %u", jump);
+    measure(name, kRepeatCount, [&]() {
+      std::uint64_t checksum = 0;
+      std::size_t index = 0;
+      for (std::uint32_t target = block.front(); index < block.size();
+           target += jump * 4) {
+        index = indexer::LowerBound(block.data(), block.size(), index, target);
+        checksum += index;
+      }
+      return checksum;
+    });
+  }
+
+  struct Lists {
+    const char *name;
+    std::size_t a_count;
+    std::uint32_t a_gap;
+    std::size_t b_count;
+    std::uint32_t b_gap;
+  };
+  for (const Lists &lists : {Lists{"IntersectSorted, 10k and 10k", 10000, 20,
+                                   10000, 20},
+                             Lists{"IntersectSorted, 1k and 100k", 1000, 400,
+                                   100000, 4},
+                             Lists{"IntersectSorted, 100 and 100k", 100, 4000,
+                                   100000, 4}}) {
+    std::vector<std::uint32_t> a =
+        sortedValues(rng, lists.a_count, lists.a_gap);
+    std::vector<std::uint32_t> b =
+        sortedValues(rng, lists.b_count, lists.b_gap);
+    std::vector<std::uint32_t> out(std::min(a.size(), b.size()));
+    measure(lists.name, kRepeatCount / 20, [&]() {
+      std::size_t count = indexer::IntersectSorted(a.data(), a.size(), b.data(),
+                                                   b.size(), out.data());
+      std::uint64_t checksum = count;
+      for (std::size_t i = 0; i < count; ++i) {
+        checksum = checksum * 31 + out[i];
+      }
+      return checksum;
+    });
+  }
+
+  return 0;
+}
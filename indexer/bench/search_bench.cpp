@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+//
+// Measures query latency of the Searcher over a synthetic corpus, and
+// checks its results against exhaustive scoring of every matching document.
+//
+// Usage: searchlight-search-bench [doc_count] [k]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "posting_iterator.hpp"
+#include "query.hpp"
+#include "searcher.hpp"
+#include "segment.hpp"
+#include "segment_writer.hpp"
+#include "simd.hpp"
+#include "snippet.hpp"
+
+namespace {
+
+constexpr std::size_t kVocabularySize = 100000;
+constexpr std::size_t kQueriesPerKind = 300;
+
+// Samples word ranks with a Zipf distribution, like words of real text
+class ZipfSampler {
+public:
+  explicit ZipfSampler(std::size_t size) : cdf(size) {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < size; ++i) {
+      sum += 1.0 / static_cast<double>(i + 1);
+      cdf[i] = sum;
+    }
+    for (double &value : cdf) {
+      value /= sum;
+    }
+  }
+
+  std::size_t operator()(std::mt19937_64 &rng) {
+    double value = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    return std::lower_bound(cdf.begin(), cdf.end(), value) - cdf.begin();
+  }
+
+private:
+  std::vector<double> cdf;
+};
+
+std::string word(std::size_t rank) { return "w" + std::to_string(rank); }
+
+// Scores every document matching the query, without pruning
+std::vector<indexer::ScoredDoc>
+searchExhaustively(const indexer::Segment &segment, const indexer::Query &query,
+                   std::size_t k) {
+  indexer::Searcher searcher(segment);
+
+  // Repeated terms count once, as they do in Searcher, and phrase terms are
+  // always required
+  std::map<std::string, bool> terms;
+  for (const std::string &term : query.terms) {
+    terms[term] = terms[term] || !query.is_disjunction;
+  }
+  for (const auto &phrase : query.phrases) {
+    for (const std::string &term : phrase) {
+      terms[term] = true;
+    }
+  }
+
+  std::vector<indexer::PostingIterator> cursors;
+  std::vector<float> idfs;
+  std::vector<bool> is_required;
+  std::map<std::string, std::size_t> cursor_indexes;
+  for (const auto &[term, required] : terms) {
+    const indexer::TermEntry *term_entry = segment.FindTerm(term);
+    if (!term_entry) {
+      if (required) {
+        return {};
+      }
+      continue;
+    }
+    cursor_indexes[term] = cursors.size();
+    cursors.emplace_back(segment, *term_entry);
+    idfs.push_back(searcher.GetIdf(term_entry->doc_freq));
+    is_required.push_back(required);
+  }
+
+  std::vector<indexer::ScoredDoc> scored_docs;
+  std::vector<std::uint32_t> positions, other_positions;
+  while (true) {
+    std::uint32_t doc = indexer::PostingIterator::kEnd;
+    for (const auto &cursor : cursors) {
+      doc = std::min(doc, cursor.GetDoc());
+    }
+    if (doc == indexer::PostingIterator::kEnd) {
+      break;
+    }
+
+    bool is_match = true;
+    for (std::size_t i = 0; i < cursors.size(); ++i) {
+      is_match = is_match && (!is_required[i] || cursors[i].GetDoc() == doc);
+    }
+    for (const auto &phrase : query.phrases) {
+      if (!is_match || phrase.size() < 2) {
+        continue;
+      }
+      cursors[cursor_indexes[phrase[0]]].GetPositions(positions);
+      for (std::size_t i = 1; i < phrase.size(); ++i) {
+        cursors[cursor_indexes[phrase[i]]].GetPositions(other_positions);
+        std::erase_if(positions, [&](std::uint32_t start) {
+          return std::find(other_positions.begin(), other_positions.end(),
+                           start + i) == other_positions.end();
+        });
+      }
+      is_match = !positions.empty();
+    }
+
+    float score = 0.0f;
+    for (std::size_t i = 0; i < cursors.size(); ++i) {
+      if (cursors[i].GetDoc() == doc) {
+        score += searcher.Score(idfs[i], cursors[i].GetFreq(),
+                                segment.GetDocLength(doc));
+        cursors[i].Next();
+      }
+    }
+    if (is_match) {
+      scored_docs.push_back({doc, score});
+    }
+  }
+
+  std::sort(scored_docs.begin(), scored_docs.end(),
+            [](const auto &a, const auto &b) {
+              return a.score != b.score ? a.score > b.score
+                                        : a.doc_id < b.doc_id;
+            });
+  scored_docs.resize(std::min(scored_docs.size(), k));
+  return scored_docs;
+}
+
+bool haveSameScores(const std::vector<indexer::ScoredDoc> &a,
+                    const std::vector<indexer::ScoredDoc> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    float tolerance = 1e-4f * std::max(1.0f, a[i].score);
+    if (std::abs(a[i].score - b[i].score) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double microseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double percentile(std::vector<double> values, double fraction) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<std::size_t>(fraction * (values.size() - 1))];
+}
+
+void runQueries(const char *name, const indexer::Segment &segment,
+                const std::vector<std::string> &queries, std::size_t k) {
+  indexer::Searcher searcher(segment);
+  std::vector<double> latencies;
+  std::vector<double> exhaustive_latencies;
+  std::size_t mismatch_count = 0;
+  std::size_t page_mismatch_count = 0;
+  for (const std::string &text : queries) {
+    indexer::Query query = indexer::Query::Parse(text);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<indexer::ScoredDoc> top_docs = searcher.Search(query, k);
+    auto end = std::chrono::steady_clock::now();
+    latencies.push_back(microseconds(end - start));
+
+    start = std::chrono::steady_clock::now();
+    std::vector<indexer::ScoredDoc> expected =
+        searchExhaustively(segment, query, k);
+    end = std::chrono::steady_clock::now();
+    exhaustive_latencies.push_back(microseconds(end - start));
+    if (!haveSameScores(top_docs, expected)) {
+      ++mismatch_count;
+    }
+
+    // The second page, resumed from the last result of the first, has to
+    // be exactly what follows it
+    if (top_docs.size() == k) {
+      std::vector<indexer::ScoredDoc> pages = top_docs;
+      for (const indexer::ScoredDoc &scored_doc :
+           searcher.Search(query, k, top_docs.back())) {
+        pages.push_back(scored_doc);
+      }
+      std::vector<indexer::ScoredDoc> all = searcher.Search(query, 2 * k);
+      if (pages.size() != all.size() ||
+          !std::equal(pages.begin(), pages.end(), all.begin(),
+                      [](const auto &a, const auto &b) {
+                        return a.doc_id == b.doc_id && a.score == b.score;
+                      })) {
+        ++page_mismatch_count;
+      }
+    }
+  }
+
+  std::printf("%-12s p50 %9.1f us  p99 %9.1f us  | "
+              "exhaustive p50 %9.1f us  p99 %9.1f us  | mismatches %zu, "
+              "on second pages %zu\n",
+              name, percentile(latencies, 0.5), percentile(latencies, 0.99),
+              percentile(exhaustive_latencies, 0.5),
+              percentile(exhaustive_latencies, 0.99), mismatch_count,
+              page_mismatch_count);
+}
+
+// Times ranking followed by snippets for every result, as the server does
+void runSnippets(const char *name, const indexer::Segment &segment,
+                 const std::vector<std::string> &queries, std::size_t k) {
+  indexer::Searcher searcher(segment);
+  std::vector<double> latencies;
+  for (const std::string &text : queries) {
+    auto start = std::chrono::steady_clock::now();
+    indexer::Query query = indexer::Query::Parse(text);
+    std::vector<std::uint32_t> doc_ids;
+    for (const indexer::ScoredDoc &scored_doc : searcher.Search(query, k)) {
+      doc_ids.push_back(scored_doc.doc_id);
+    }
+    indexer::MakeSnippets(segment, query, doc_ids,
+                          std::chrono::microseconds(500));
+    latencies.push_back(microseconds(std::chrono::steady_clock::now() - start));
+  }
+
+  std::printf("%-12s p50 %9.1f us  p99 %9.1f us  (with snippets)\n", name,
+              percentile(latencies, 0.5), percentile(latencies, 0.99));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t doc_count =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  std::size_t k = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+  std::mt19937_64 rng(42);
+  ZipfSampler sampler(kVocabularySize);
+  std::uniform_int_distribution<std::size_t> doc_length(20, 400);
+
+  std::printf("Building a segment of %zu documents...\n", doc_count);
+  indexer::SegmentWriter segment_writer;
+  std::vector<std::vector<std::size_t>> sample_docs;
+  for (std::size_t i = 0; i < doc_count; ++i) {
+    std::vector<std::size_t> ranks(doc_length(rng));
+    std::string text;
+    for (std::size_t &rank : ranks) {
+      rank = sampler(rng);
+      text += word(rank);
+      text += ' ';
+    }
+    segment_writer.AddDocument("https://example.com/" + std::to_string(i), "",
+                               text);
+    if (i % 100 == 0) {
+      sample_docs.push_back(std::move(ranks));
+    }
+  }
+
+  auto segment_path =
+      std::filesystem::temp_directory_path() / "searchlight-bench.seg";
+  if (!segment_writer.Write(segment_path.string(), 0)) {
+    return 1;
+  }
+  indexer::Segment segment(segment_path.string());
+  std::printf("%llu terms, average length %.1f, k = %zu, %s kernels\n\n",
+              static_cast<unsigned long long>(segment.GetTermCount()),
+              segment.GetAverageDocLength(), k,
+              indexer::GetSimdLevelName(indexer::GetSimdLevel()));
+
+  // Common words are where pruning matters, so queries mix them with rarer
+  // ones the way real queries do
+  std::uniform_int_distribution<std::size_t> common(0, 50);
+  std::uniform_int_distribution<std::size_t> medium(50, 2000);
+  std::uniform_int_distribution<std::size_t> sample(0, sample_docs.size() - 1);
+  std::vector<std::string> and_queries, common_and_queries, or_queries,
+      phrase_queries;
+  for (std::size_t i = 0; i < kQueriesPerKind; ++i) {
+    and_queries.push_back(word(common(rng)) + " " + word(medium(rng)));
+    common_and_queries.push_back(word(common(rng)) + " " + word(common(rng)));
+    or_queries.push_back(word(common(rng)) + " OR " + word(medium(rng)) +
+                         " OR " + word(medium(rng)));
+
+    const auto &ranks = sample_docs[sample(rng)];
+    std::size_t start =
+        std::uniform_int_distribution<std::size_t>(0, ranks.size() - 2)(rng);
+    phrase_queries.push_back("\"" + word(ranks[start]) + " " +
+                             word(ranks[start + 1]) + "\"");
+  }
+
+  runQueries("AND", segment, and_queries, k);
+  runQueries("AND common", segment, common_and_queries, k);
+  runQueries("OR", segment, or_queries, k);
+  runQueries("phrase", segment, phrase_queries, k);
+  runSnippets("AND", segment, and_queries, k);
+  runSnippets("phrase", segment, phrase_queries, k);
+
+  std::filesystem::remove(segment_path);
+  return 0;
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+//
+// Measures the build time, size and lookup latency of a completion trie over
+// a synthetic vocabulary, and checks its completions against a scan of the
+// sorted vocabulary.
+//
+// Usage: searchlight-suggest-bench [term_count] [k]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "completion_trie.hpp"
+#include "completion_writer.hpp"
+
+namespace {
+
+constexpr std::size_t kLookupsPerLength = 2000;
+
+struct Term {
+  std::string text;
+  std::uint32_t weight;
+};
+
+// Letters are drawn with English frequencies, so that prefixes are shared
+// the way they are in a real vocabulary
+std::string randomWord(std::mt19937_64 &rng) {
+  static constexpr char kLetters[] = "etaoinshrdlcumwfgypbvkjxqz";
+  static const std::vector<double> kFrequencies = {
+      12.7, 9.1, 8.2, 7.5, 7.0, 6.7, 6.3, 6.1, 6.0, 4.3, 4.0, 2.8, 2.8,
+      2.4,  2.4, 2.2, 2.0, 2.0, 1.9, 1.5, 1.0, 0.8, 0.2, 0.2, 0.1, 0.1};
+  std::discrete_distribution<int> letter(kFrequencies.begin(),
+                                         kFrequencies.end());
+  std::uniform_int_distribution<int> length(3, 12);
+  std::string word(length(rng), ' ');
+  for (char &c : word) {
+    c = kLetters[letter(rng)];
+  }
+  return word;
+}
+
+std::vector<indexer::Completion> completeByScan(const std::vector<Term> &terms,
+                                                const std::string &prefix,
+                                                std::size_t k) {
+  auto begin = std::lower_bound(
+      terms.begin(), terms.end(), prefix,
+      [](const Term &term, const std::string &text) { return term.text < text; });
+  std::vector<indexer::Completion> completions;
+  for (auto it = begin; it != terms.end() && it->text.starts_with(prefix);
+       ++it) {
+    completions.push_back({it->text, it->weight});
+  }
+  std::size_t count = std::min(completions.size(), k);
+  std::partial_sort(completions.begin(), completions.begin() + count,
+                    completions.end(), [](const auto &a, const auto &b) {
+                      return a.weight != b.weight ? a.weight > b.weight
+                                                  : a.term < b.term;
+                    });
+  completions.resize(count);
+  return completions;
+}
+
+double microseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+double percentile(std::vector<double> values, double fraction) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<std::size_t>(fraction * (values.size() - 1))];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t term_count =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+  std::size_t k = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+
+  // Weights follow a Zipf distribution, like document frequencies do
+  std::mt19937_64 rng(42);
+  std::vector<Term> terms;
+  terms.reserve(term_count);
+  for (std::size_t i = 0; i < term_count; ++i) {
+    terms.push_back({randomWord(rng), 0});
+  }
+  std::sort(terms.begin(), terms.end(),
+            [](const Term &a, const Term &b) { return a.text < b.text; });
+  terms.erase(std::unique(terms.begin(), terms.end(),
+                          [](const Term &a, const Term &b) {
+                            return a.text == b.text;
+                          }),
+              terms.end());
+  std::vector<std::uint32_t> ranks(terms.size());
+  for (std::size_t i = 0; i < ranks.size(); ++i) {
+    ranks[i] = static_cast<std::uint32_t>(i + 1);
+  }
+  std::shuffle(ranks.begin(), ranks.end(), rng);
+  for (std::size_t i = 0; i < terms.size(); ++i) {
+    terms[i].weight = std::max<std::uint32_t>(1, 1000000 / ranks[i]);
+  }
+
+  auto path = std::filesystem::temp_directory_path() / "searchlight-bench.sug";
+  auto start = std::chrono::steady_clock::now();
+  indexer::CompletionWriter completion_writer;
+  for (const Term &term : terms) {
+    completion_writer.AddTerm(term.text, term.weight);
+  }
+  if (!completion_writer.Write(path.string(), 0)) {
+    return 1;
+  }
+  auto build_time = std::chrono::steady_clock::now() - start;
+
+  indexer::CompletionTrie trie(path.string());
+  std::printf("%zu terms, built in %.0f ms, %.1f MiB, k = %zu\n\n",
+              terms.size(), microseconds(build_time) / 1000.0,
+              static_cast<double>(std::filesystem::file_size(path)) /
+                  (1024 * 1024),
+              k);
+
+  std::uniform_int_distribution<std::size_t> sample(0, terms.size() - 1);
+  for (std::size_t length = 1; length <= 5; ++length) {
+    std::vector<double> latencies;
+    std::size_t mismatch_count = 0;
+    for (std::size_t i = 0; i < kLookupsPerLength; ++i) {
+      std::string prefix = terms[sample(rng)].text.substr(0, length);
+      start = std::chrono::steady_clock::now();
+      std::vector<indexer::Completion> completions = trie.Complete(prefix, k);
+      latencies.push_back(
+          microseconds(std::chrono::steady_clock::now() - start));
+
+      std::vector<indexer::Completion> expected =
+          completeByScan(terms, prefix, k);
+      if (!std::equal(completions.begin(), completions.end(), expected.begin(),
+                      expected.end(), [](const auto &a, const auto &b) {
+                        return a.term == b.term && a.weight == b.weight;
+                      })) {
+        ++mismatch_count;
+      }
+    }
+    std::printf("prefix length %zu  p50 %7.1f us  p99 %7.1f us  | "
+                "mismatches %zu\n",
+                length, percentile(latencies, 0.5),
+                percentile(latencies, 0.99), mismatch_count);
+  }
+
+  std::filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "segment_format.hpp"
+
+namespace indexer {
+
+// Number of 32-bit words a block of kBlockSize values packed with `bits`
+// bits each takes.
+constexpr std::size_t PackedBlockWords(std::uint32_t bits) {
+  return kBlockSize * bits / 32;
+}
+
+// Smallest bit width that can hold every one of the kBlockSize values.
+std::uint32_t RequiredBits(const std::uint32_t *values);
+
+// Packs kBlockSize values with `bits` bits each into PackedBlockWords(bits)
+// words. Values are spread over 4 interleaved lanes, value i going to lane
+// i % 4 and word k of a lane being stored at 4 * k + lane, so that four
+// values can be unpacked at once with 128-bit vector instructions.
+void PackBlock(const std::uint32_t *values, std::uint32_t bits,
+               std::uint32_t *out);
+
+// Reverses PackBlock into kBlockSize values. Uses SSE4.1 when the CPU
+// supports it.
+void UnpackBlock(const std::uint32_t *in, std::uint32_t bits,
+                 std::uint32_t *values);
+
+// Turns `count` document gaps, each stored as the distance to the previous
+// document minus one, into document ids, in place. `first` is the smallest
+// id the first document can have (one past the previous block).
+void DecodeGaps(std::uint32_t *values, std::size_t count,
+                std::uint32_t first);
+
+void AppendVarint(std::string &out, std::uint32_t value);
+
+// Decodes the varint at `in` and returns a pointer past it. The data is
+// trusted to be well-formed, as it is only ever read from our own segments.
+inline const std::uint8_t *ReadVarint(const std::uint8_t *in,
+                                      std::uint32_t &value) {
+  std::uint32_t result = 0;
+  for (int shift = 0;; shift += 7) {
+    std::uint8_t byte = *in++;
+    result |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  value = result;
+  return in;
+}
+
+} // namespace indexer
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace indexer {
+
+// Page bodies are stored as raw deflate streams primed with a preset
+// dictionary: markup that most pages of a crawl share (doctype, head,
+// navigation, footer) is then encoded as references into the dictionary
+// from the first byte of a page, instead of once per page. Deflate only
+// looks 32 KiB back, so that is all of a dictionary it can use.
+constexpr std::size_t kMaxDictionarySize = 32 * 1024;
+
+// Only the start of a sample is used for training: shared markup is mostly
+// there, and bounded samples keep training time and memory in check.
+constexpr std::size_t kMaxDictionarySampleSize = 16 * 1024;
+
+// Builds a dictionary of up to `size` bytes out of sample bodies. Segments
+// of the samples are picked greedily by the number of samples their 8-byte
+// substrings appear in, not counting substrings an earlier pick already
+// covers, and the best segments are put last, where they are the cheapest
+// to refer to.
+std::string TrainDictionary(const std::vector<std::string> &samples,
+                            std::size_t size = kMaxDictionarySize);
+
+// Compresses bodies one after the other, reusing the same deflate state.
+class BodyCompressor {
+public:
+  // `level` is a zlib compression level, from 1 (fastest) to 9 (smallest).
+  // Throws if zlib cannot be initialized.
+  explicit BodyCompressor(int level);
+  ~BodyCompressor();
+
+  BodyCompressor(const BodyCompressor &) = delete;
+  BodyCompressor &operator=(const BodyCompressor &) = delete;
+
+  // Primes every following body with `dictionary`, or with nothing if it is
+  // empty.
+  void SetDictionary(std::string dictionary);
+
+  // Returns false on error.
+  bool Compress(std::string_view body, std::string &compressed);
+
+private:
+  struct Stream;
+
+  std::unique_ptr<Stream> stream;
+  std::string dictionary;
+};
+
+// Decompresses a body compressed with `dictionary` into `body`, which is
+// `size` bytes long. Returns false if it is corrupted.
+bool DecompressBody(std::string_view compressed, std::string_view dictionary,
+                    std::size_t size, std::string &body);
+
+} // namespace indexer
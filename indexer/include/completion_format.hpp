@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+// On-disk layout of a completion trie, which maps the vocabulary of a
+// segment to term weights for prefix completion. Like a segment, it is an
+// immutable file that is memory-mapped and read in place.
+//
+//   CompletionHeader
+//   CompletionNode[node_count]   node 0 is the root
+//   labels
+//
+// The trie is path-compressed: every node but the root has a label of one
+// or more bytes, and the children of a node, stored next to each other,
+// start with distinct bytes, in increasing order. A node where a term ends
+// has that term's weight. Every node also records the highest weight in
+// its subtree, so that the best completions of a prefix can be found
+// best-first without visiting the rest of the subtree.
+namespace indexer {
+
+static_assert(std::endian::native == std::endian::little,
+              "Completion tries are only read and written on little-endian "
+              "hosts");
+
+inline constexpr char kCompletionMagic[8] = {'S', 'L', 'S', 'U', 'G', 0, 0, 0};
+inline constexpr std::uint32_t kCompletionVersion = 1;
+
+struct CompletionHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t node_count;
+  std::uint64_t term_count;
+  // Index generation of the database the vocabulary comes from
+  std::uint64_t source_generation;
+  // Absolute file offsets of the sections
+  std::uint64_t nodes_offset;
+  std::uint64_t labels_offset;
+  std::uint64_t file_size;
+};
+
+struct CompletionNode {
+  std::uint32_t first_child;
+  std::uint32_t label_offset;
+  // Weight of the term ending at the node, or 0 if none does
+  std::uint32_t weight;
+  // Highest weight of the node and its descendants
+  std::uint32_t max_weight;
+  std::uint16_t child_count;
+  std::uint8_t label_length;
+  std::uint8_t reserved;
+};
+
+static_assert(sizeof(CompletionHeader) == 56);
+static_assert(sizeof(CompletionNode) == 20);
+
+} // namespace indexer
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "completion_format.hpp"
+#include "mapped_file.hpp"
+
+namespace indexer {
+
+struct Completion {
+  std::string term;
+  std::uint32_t weight;
+};
+
+// A read-only view of a completion trie file, memory-mapped like a segment.
+class CompletionTrie {
+public:
+  // Maps the trie at `path`. Throws if it cannot be opened or is not a valid
+  // completion trie.
+  explicit CompletionTrie(const std::string &path);
+
+  std::uint64_t GetTermCount() const;
+
+  std::uint64_t GetSourceGeneration() const;
+
+  // Returns the `k` terms starting with `prefix` that have the highest
+  // weights, best first, and in sorted order among equal weights.
+  std::vector<Completion> Complete(std::string_view prefix,
+                                   std::size_t k) const;
+
+private:
+  MappedFile file;
+  const CompletionHeader *header = nullptr;
+  const CompletionNode *nodes = nullptr;
+  const char *labels = nullptr;
+
+  std::string_view getLabel(const CompletionNode &node) const;
+
+  // Returns the child of the node whose label starts with `c`, or nullptr.
+  const CompletionNode *findChild(const CompletionNode &node, char c) const;
+
+  void validate(const std::string &path) const;
+};
+
+} // namespace indexer
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "completion_format.hpp"
+
+namespace indexer {
+
+// Builds a completion trie from a sorted vocabulary and writes it out in the
+// format described in completion_format.hpp.
+class CompletionWriter {
+public:
+  // Adds a term, which must sort after the previous one. Terms with a weight
+  // of 0 are never suggested. Returns false if the term is out of order or
+  // too long.
+  bool AddTerm(std::string_view term, std::uint32_t weight);
+
+  std::size_t GetTermCount() const;
+
+  // Writes the trie to a temporary file and renames it to `path`. Returns
+  // false on I/O error.
+  bool Write(const std::string &path, std::uint64_t source_generation) const;
+
+private:
+  struct Term {
+    std::string text;
+    std::uint32_t weight;
+  };
+
+  std::vector<Term> terms;
+
+  // Appends nodes for the terms in [begin, end), which share their first
+  // `depth` bytes, grouped by their next byte. Returns the highest weight.
+  std::uint32_t buildChildren(std::size_t begin, std::size_t end,
+                              std::size_t depth, std::size_t parent,
+                              std::vector<CompletionNode> &nodes,
+                              std::string &labels) const;
+};
+
+} // namespace indexer
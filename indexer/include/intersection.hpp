@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace indexer {
+
+// Returns the index of the first of `values[from, count)` that is at least
+// `target`, or `count`. `values` must be sorted. Gallops from `from` to find
+// the range the target is in, then compares several values at once with
+// SSE4.1 or AVX2 when the CPU supports them, so that both short and long
+// jumps are cheap.
+std::size_t LowerBound(const std::uint32_t *values, std::size_t count,
+                       std::size_t from, std::uint32_t target);
+
+// Writes the values found in both sorted lists `a` and `b` to `out`, in
+// order, and returns how many there are. `out` must not overlap the lists.
+// Lists of similar lengths are merged, a vector of each compared against
+// the other at a time; when one is much longer, every value of the shorter
+// one is looked up in it with LowerBound instead.
+std::size_t IntersectSorted(const std::uint32_t *a, std::size_t a_count,
+                            const std::uint32_t *b, std::size_t b_count,
+                            std::uint32_t *out);
+
+} // namespace indexer
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace indexer {
+
+// A whole file mapped read-only into memory. The mapping is shared with
+// every other process reading the file, and stays valid after the file is
+// replaced by a newer one.
+class MappedFile {
+public:
+  // Throws if the file cannot be opened or mapped.
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const std::uint8_t *GetData() const;
+
+  std::size_t GetSize() const;
+
+private:
+  const std::uint8_t *data = nullptr;
+  std::size_t size = 0;
+};
+
+// Writes `data` to a temporary file next to `path` and renames it over
+// `path` once it is on disk, so that readers of the previous file never see
+// a partial one. Returns false on I/O error.
+bool WriteFileAtomically(const std::string &path, std::string_view data);
+
+} // namespace indexer
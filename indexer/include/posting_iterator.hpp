@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "segment.hpp"
+#include "segment_format.hpp"
+
+namespace indexer {
+
+// Walks the posting list of one term in document order, decoding one block
+// at a time. Advance() uses the skip table to jump over blocks that cannot
+// contain the target without decoding them, and ShallowAdvance() looks at
+// the skip table alone, to bound scores before deciding to decode at all.
+class PostingIterator {
+public:
+  // Document id returned once the list is exhausted
+  static constexpr std::uint32_t kEnd = UINT32_MAX;
+
+  // Starts positioned on the first document of the list.
+  PostingIterator(const Segment &segment, const TermEntry &term_entry);
+
+  std::uint32_t GetDoc() const;
+
+  // Number of occurrences of the term in the current document.
+  std::uint32_t GetFreq() const;
+
+  std::uint32_t GetDocFreq() const;
+
+  // Impact bounds of the whole posting list.
+  std::uint32_t GetMaxFreq() const;
+  std::uint32_t GetMinDocLength() const;
+
+  // Moves to the next document and returns it, or kEnd.
+  std::uint32_t Next();
+
+  // Moves to the first document at or after `target` and returns it, or
+  // kEnd. Never moves backwards.
+  std::uint32_t Advance(std::uint32_t target);
+
+  // Replaces `positions` with the positions of the term in the current
+  // document, in increasing order.
+  void GetPositions(std::vector<std::uint32_t> &positions);
+
+  // Finds the block that would hold `target`, without decoding it or moving
+  // the current document. Returns its skip entry, which bounds the documents
+  // from `target` to its last_doc, or null if `target` is past the end.
+  // Targets must not decrease between calls.
+  const SkipEntry *ShallowAdvance(std::uint32_t target);
+
+private:
+  const SkipEntry *skip_entries;
+  const std::uint8_t *blocks;
+  const std::uint8_t *positions;
+  std::uint32_t doc_freq;
+  std::uint32_t block_count;
+  std::uint32_t max_freq;
+  std::uint32_t min_doc_length;
+
+  std::uint32_t block = 0;
+  // Never behind `block`
+  std::uint32_t shallow_block = 0;
+  std::uint32_t block_doc_count = 0;
+  std::uint32_t index_in_block = 0;
+  std::uint32_t doc = kEnd;
+  std::uint32_t docs[kBlockSize];
+  std::uint32_t freqs[kBlockSize];
+
+  // Start of the positions of the document at positions_cursor_index
+  const std::uint8_t *positions_cursor = nullptr;
+  std::uint32_t positions_cursor_index = 0;
+
+  void loadBlock(std::uint32_t block);
+};
+
+} // namespace indexer
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace indexer {
+
+// A parsed search query.
+//
+// Words match pages containing all of them, or any of them if the query
+// contains the word OR. Quoted phrases must always match, with their words
+// next to each other and in order.
+struct Query {
+  std::vector<std::string> terms;
+  std::vector<std::vector<std::string>> phrases;
+  bool is_disjunction = false;
+
+  static Query Parse(std::string_view text);
+
+  bool IsEmpty() const;
+};
+
+} // namespace indexer
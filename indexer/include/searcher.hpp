@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "query.hpp"
+#include "segment.hpp"
+
+namespace indexer {
+
+struct ScoredDoc {
+  std::uint32_t doc_id;
+  float score;
+};
+
+// Finds the best documents of a segment for a query, ranked with BM25.
+//
+// Only the k best documents are kept, in a heap, and the lowest score among
+// them is a threshold any other document has to beat. Block-max WAND (for
+// queries where every term is optional) and block-max pruning of
+// conjunctions bound the score of whole blocks from their impact bounds and
+// skip the ones that cannot beat it, so the cost of a query grows with k
+// rather than with how common its terms are.
+class Searcher {
+public:
+  explicit Searcher(const Segment &segment);
+
+  // Returns the k best documents for the query, best first. If `after` is
+  // given, only documents ranked after it are returned, so that the next
+  // page of results resumes from the last one of the previous page. Ties in
+  // score are broken by document id, and scores are computed the same way
+  // every time, so pages neither overlap nor leave gaps.
+  std::vector<ScoredDoc>
+  Search(const Query &query, std::size_t k,
+         std::optional<ScoredDoc> after = std::nullopt) const;
+
+  // Scores a document with `freq` occurrences of a term of inverse document
+  // frequency `idf`.
+  float Score(float idf, std::uint32_t freq, std::uint32_t doc_length) const;
+
+  float GetIdf(std::uint32_t doc_freq) const;
+
+private:
+  // BM25 parameters
+  static constexpr float kK1 = 1.2f;
+  static constexpr float kB = 0.75f;
+
+  const Segment &segment;
+  float average_doc_length;
+};
+
+} // namespace indexer
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.hpp"
+#include "segment_format.hpp"
+
+namespace indexer {
+
+// A read-only view of a segment file. The file is memory-mapped and read in
+// place: nothing is copied or decoded up front, so opening a segment is
+// cheap and its pages are shared with every other process reading it.
+class Segment {
+public:
+  // Maps the segment at `path`. Throws if it cannot be opened or is not a
+  // valid segment.
+  explicit Segment(const std::string &path);
+
+  Segment(const Segment &) = delete;
+  Segment &operator=(const Segment &) = delete;
+
+  std::uint32_t GetDocCount() const;
+
+  std::uint64_t GetTermCount() const;
+
+  double GetAverageDocLength() const;
+
+  std::uint64_t GetSourceGeneration() const;
+
+  std::uint32_t GetDocLength(std::uint32_t doc_id) const;
+
+  std::string_view GetUrl(std::uint32_t doc_id) const;
+
+  std::string_view GetTitle(std::uint32_t doc_id) const;
+
+  // Returns the stored text of the document, which may only be the start of
+  // the text that was indexed.
+  std::string_view GetText(std::uint32_t doc_id) const;
+
+  // Looks a term up in the dictionary, which is sorted, with a binary search.
+  const TermEntry *FindTerm(std::string_view term) const;
+
+  // Terms are numbered in sorted order, from 0 to GetTermCount() - 1.
+  const TermEntry &GetTermEntry(std::uint64_t index) const;
+
+  std::string_view GetTerm(const TermEntry &term_entry) const;
+
+  // Returns a pointer to `offset` bytes into the file.
+  const std::uint8_t *GetData(std::uint64_t offset) const;
+
+private:
+  MappedFile file;
+  const std::uint8_t *data = nullptr;
+  std::size_t size = 0;
+  const SegmentHeader *header = nullptr;
+  const TermEntry *term_entries = nullptr;
+  const std::uint32_t *doc_lengths = nullptr;
+  const DocEntry *doc_entries = nullptr;
+
+  void validate(const std::string &path) const;
+};
+
+} // namespace indexer
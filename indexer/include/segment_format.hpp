@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+// On-disk layout of an index segment. A segment is a single immutable file
+// that is memory-mapped and read in place, so every structure here is plain
+// little-endian data at a naturally aligned offset.
+//
+//   SegmentHeader
+//   TermEntry[term_count]        sorted by term, for binary search
+//   term strings
+//   postings                     per term: SkipEntry[block_count], blocks
+//   positions                    per term: varint position deltas
+//   uint32_t[doc_count]          document lengths (norms)
+//   DocEntry[doc_count]
+//   document strings             urls, titles and texts
+//
+// Postings are split into blocks of kBlockSize documents. A full block
+// starts with a word holding the bit widths of its document gaps and of its
+// term frequencies, followed by both bit-packed (see bit_packing.hpp). The
+// last block of a term, if shorter, is varint-encoded instead. Blocks are
+// padded to 4 bytes.
+//
+// Terms and blocks record their highest term frequency and their shortest
+// document. Together they bound the score of any document in them, which
+// lets queries skip blocks that cannot make it into the top results.
+//
+// Positions count the tokens of the title, then those of the text after a
+// gap of kFieldPositionGap. The text is also stored, with its whitespace
+// collapsed and cut to a bounded length, so that snippets can be cut out of
+// it from the positions of the query terms.
+namespace indexer {
+
+static_assert(std::endian::native == std::endian::little,
+              "Segments are only read and written on little-endian hosts");
+
+inline constexpr char kSegmentMagic[8] = {'S', 'L', 'S', 'E', 'G', 0, 0, 0};
+inline constexpr std::uint32_t kSegmentVersion = 3;
+
+inline constexpr std::uint32_t kBlockSize = 128;
+
+// Gap left between the positions of the title and the text, so that
+// phrases do not match across them
+inline constexpr std::uint32_t kFieldPositionGap = 8;
+
+struct SegmentHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t doc_count;
+  std::uint64_t term_count;
+  // Sum of all document lengths, for the average used by BM25
+  std::uint64_t total_doc_length;
+  // Index generation of the database the segment was built from
+  std::uint64_t source_generation;
+  // Absolute file offsets of the sections
+  std::uint64_t terms_offset;
+  std::uint64_t doc_lengths_offset;
+  std::uint64_t docs_offset;
+  std::uint64_t file_size;
+};
+
+struct TermEntry {
+  std::uint64_t string_offset;
+  std::uint32_t string_length;
+  std::uint32_t doc_freq;
+  std::uint64_t postings_offset;
+  std::uint64_t positions_offset;
+  std::uint32_t max_freq;
+  std::uint32_t min_doc_length;
+};
+
+struct SkipEntry {
+  std::uint32_t last_doc;
+  // Relative to the first block of the term
+  std::uint32_t block_offset;
+  // Relative to the positions of the term
+  std::uint32_t positions_offset;
+  std::uint32_t max_freq;
+  std::uint32_t min_doc_length;
+};
+
+struct DocEntry {
+  std::uint64_t url_offset;
+  std::uint64_t title_offset;
+  std::uint64_t text_offset;
+  std::uint32_t url_length;
+  std::uint32_t title_length;
+  std::uint32_t text_length;
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(SegmentHeader) == 72);
+static_assert(sizeof(TermEntry) == 40);
+static_assert(sizeof(SkipEntry) == 20);
+static_assert(sizeof(DocEntry) == 40);
+
+} // namespace indexer
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "segment_format.hpp"
+
+namespace indexer {
+
+// Builds a segment in memory, one document at a time, and writes it out in
+// the format described in segment_format.hpp.
+class SegmentWriter {
+public:
+  // Tokenizes the title and the text and adds them as the next document.
+  // Returns the id of the document; ids are assigned in order from 0.
+  std::uint32_t AddDocument(std::string_view url, std::string_view title,
+                            std::string_view text);
+
+  std::uint32_t GetDocCount() const;
+
+  std::size_t GetTermCount() const;
+
+  // Writes the segment to a temporary file and renames it to `path`, so that
+  // readers of the previous segment never see a partial file. Returns false
+  // on I/O error.
+  bool Write(const std::string &path, std::uint64_t source_generation) const;
+
+private:
+  struct TermPostings {
+    std::vector<std::uint32_t> docs;
+    std::vector<std::uint32_t> freqs;
+    // Positions of every occurrence, grouped by document
+    std::vector<std::uint32_t> positions;
+  };
+
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view text) const {
+      return std::hash<std::string_view>{}(text);
+    }
+  };
+
+  std::unordered_map<std::string, TermPostings, StringHash, std::equal_to<>>
+      terms;
+  std::vector<std::uint32_t> doc_lengths;
+  // Offsets are relative to doc_strings until the segment is written
+  std::vector<DocEntry> docs;
+  std::string doc_strings;
+  std::uint64_t total_doc_length = 0;
+
+  void addToken(std::string_view token, std::uint32_t doc_id,
+                std::uint32_t position);
+
+  // Appends the skip table and blocks of a term to `postings` and its
+  // positions to `positions`, and records its impact bounds in the entry.
+  void encodePostings(const TermPostings &term_postings, TermEntry &term_entry,
+                      std::string &postings, std::string &positions) const;
+};
+
+} // namespace indexer
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SEARCHLIGHT_HAS_X86_SIMD 1
+#else
+#define SEARCHLIGHT_HAS_X86_SIMD 0
+#endif
+
+namespace indexer {
+
+// Instruction sets the posting list kernels (block unpacking, gap decoding
+// and sorted list search) have versions for. The kernels are compiled for
+// every level with target attributes, and the level is picked at runtime
+// from what the CPU supports, so that one binary runs everywhere.
+enum class SimdLevel { kScalar, kSse41, kAvx2 };
+
+// Best level the CPU supports.
+SimdLevel GetSupportedSimdLevel();
+
+// Level the kernels use, the supported one unless lowered.
+SimdLevel GetSimdLevel();
+
+// Makes the kernels use `level`, or the supported level if it is lower.
+// Meant for benchmarks and for comparing results, not to be changed while
+// other threads search.
+void SetSimdLevel(SimdLevel level);
+
+const char *GetSimdLevelName(SimdLevel level);
+
+} // namespace indexer
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "query.hpp"
+#include "segment.hpp"
+
+namespace indexer {
+
+// Byte range of a snippet's text where a query term appears
+struct Highlight {
+  std::uint32_t begin;
+  std::uint32_t end;
+};
+
+struct Snippet {
+  std::string text;
+  // In order, and never overlapping
+  std::vector<Highlight> highlights;
+};
+
+// Cuts a snippet for each of `doc_ids` out of its stored text, in the same
+// order, around the passage with the most distinct query terms.
+//
+// The passage is found from the positions of the query terms in the
+// segment, so nothing is tokenized but the stored text up to its end, and
+// the posting lists are walked once for all documents. A document that
+// takes longer than `time_budget` gets the start of its text instead.
+std::vector<Snippet> MakeSnippets(const Segment &segment, const Query &query,
+                                  std::span<const std::uint32_t> doc_ids,
+                                  std::chrono::microseconds time_budget);
+
+} // namespace indexer
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace indexer {
+
+// Tokens longer than this are not indexed; they are mostly identifiers,
+// hashes or base64 rather than words anyone searches for.
+inline constexpr std::size_t kMaxTokenLength = 64;
+
+inline bool IsTokenChar(unsigned char c) {
+  // Bytes of multi-byte UTF-8 sequences are kept as part of words
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+// Byte range of a token in the text it was found in
+struct TokenSpan {
+  std::size_t begin;
+  std::size_t end;
+};
+
+// Finds the first token of `text` that starts at or after `offset`, skipping
+// the ones too long to be indexed. Every token it finds has a position in
+// the index, counting from 0, so scanning the same text again recovers
+// where each position is.
+inline std::optional<TokenSpan> FindNextToken(std::string_view text,
+                                              std::size_t offset) {
+  while (offset < text.size()) {
+    while (offset < text.size() && !IsTokenChar(text[offset])) {
+      ++offset;
+    }
+    std::size_t begin = offset;
+    while (offset < text.size() && IsTokenChar(text[offset])) {
+      ++offset;
+    }
+    if (offset > begin && offset - begin <= kMaxTokenLength) {
+      return TokenSpan{begin, offset};
+    }
+  }
+  return std::nullopt;
+}
+
+// Splits text into lowercase tokens and calls `on_token` with each one, in
+// order. Documents and queries go through the same function, so that they
+// always agree on what a term is. The token passed is only valid during the
+// call.
+template <typename Callback>
+void ForEachToken(std::string_view text, Callback &&on_token) {
+  char token[kMaxTokenLength];
+  std::size_t offset = 0;
+  while (std::optional<TokenSpan> span = FindNextToken(text, offset)) {
+    std::size_t length = span->end - span->begin;
+    for (std::size_t i = 0; i < length; ++i) {
+      char c = text[span->begin + i];
+      token[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    on_token(std::string_view(token, length));
+    offset = span->end;
+  }
+}
+
+// Returns the text of an HTML document: markup, comments, scripts and styles
+// are dropped and character references are decoded. Tags become spaces, so
+// that words in separate elements are not glued together.
+std::string ExtractText(std::string_view html);
+
+// Collapses runs of whitespace in `text` into single spaces and trims it,
+// then cuts it at the last space before `max_length` bytes if it is longer.
+// Tokens, and so positions, are the same as in `text` up to the cut.
+std::string CompactText(std::string_view text, std::size_t max_length);
+
+} // namespace indexer
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "bit_packing.hpp"
+
+#include <bit>
+
+#include "simd.hpp"
+
+#if SEARCHLIGHT_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace indexer {
+
+namespace {
+
+constexpr std::uint32_t kLaneCount = 4;
+constexpr std::uint32_t kValuesPerLane = kBlockSize / kLaneCount;
+
+std::uint32_t getMask(std::uint32_t bits) {
+  return bits == 32 ? UINT32_MAX : (1U << bits) - 1;
+}
+
+void unpackBlockScalar(const std::uint32_t *in, std::uint32_t bits,
+                       std::uint32_t *values) {
+  std::uint32_t mask = getMask(bits);
+  for (std::uint32_t j = 0; j < kValuesPerLane; ++j) {
+    std::uint32_t bit = j * bits;
+    std::uint32_t word = bit / 32;
+    std::uint32_t shift = bit % 32;
+    for (std::uint32_t lane = 0; lane < kLaneCount; ++lane) {
+      std::uint64_t value = in[word * kLaneCount + lane] >> shift;
+      if (shift + bits > 32) {
+        value |= static_cast<std::uint64_t>(in[(word + 1) * kLaneCount + lane])
+                 << (32 - shift);
+      }
+      values[j * kLaneCount + lane] = static_cast<std::uint32_t>(value) & mask;
+    }
+  }
+}
+
+void decodeGapsScalar(std::uint32_t *values, std::size_t count,
+                      std::uint32_t first) {
+  for (std::size_t i = 0; i < count; ++i) {
+    first += values[i];
+    values[i] = first;
+    ++first;
+  }
+}
+
+#if SEARCHLIGHT_HAS_X86_SIMD
+
+// The four lanes of a row are four consecutive values, so a row is unpacked
+// with one shift of a 128-bit vector. Two rows per 256-bit vector need a
+// lane insert and variable shifts per row, which makes them slower than
+// this, so AVX2 uses this one too.
+__attribute__((target("sse4.1"))) void
+unpackBlockSse41(const std::uint32_t *in, std::uint32_t bits,
+                 std::uint32_t *values) {
+  const auto *rows = reinterpret_cast<const __m128i *>(in);
+  auto *out = reinterpret_cast<__m128i *>(values);
+  __m128i mask = _mm_set1_epi32(static_cast<int>(getMask(bits)));
+  for (std::uint32_t j = 0; j < kValuesPerLane; ++j) {
+    std::uint32_t bit = j * bits;
+    std::uint32_t word = bit / 32;
+    std::uint32_t shift = bit % 32;
+    __m128i row = _mm_srl_epi32(_mm_loadu_si128(rows + word),
+                                _mm_cvtsi32_si128(static_cast<int>(shift)));
+    if (shift + bits > 32) {
+      row = _mm_or_si128(
+          row, _mm_sll_epi32(_mm_loadu_si128(rows + word + 1),
+                             _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+    }
+    _mm_storeu_si128(out + j, _mm_and_si128(row, mask));
+  }
+}
+
+// Prefix sum of four values at a time, carried over in a broadcast vector.
+// An 8-wide version needs a cross-lane step per vector that makes it no
+// faster, so AVX2 uses this one too.
+__attribute__((target("sse4.1"))) void
+decodeGapsSse41(std::uint32_t *values, std::size_t count,
+                std::uint32_t first) {
+  // Every document is one past the previous one plus its gap, so the gaps
+  // are summed plus one, starting from one before the first document
+  __m128i one = _mm_set1_epi32(1);
+  __m128i carry = _mm_set1_epi32(static_cast<int>(first - 1));
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    auto *out = reinterpret_cast<__m128i *>(values + i);
+    __m128i sums = _mm_add_epi32(_mm_loadu_si128(out), one);
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+    sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, carry);
+    _mm_storeu_si128(out, sums);
+    carry = _mm_shuffle_epi32(sums, 0xFF);
+  }
+  decodeGapsScalar(values + i, count - i,
+                   static_cast<std::uint32_t>(_mm_cvtsi128_si32(carry)) + 1);
+}
+
+#endif
+
+} // namespace
+
+std::uint32_t RequiredBits(const std::uint32_t *values) {
+  std::uint32_t all_bits = 0;
+  for (std::uint32_t i = 0; i < kBlockSize; ++i) {
+    all_bits |= values[i];
+  }
+  return static_cast<std::uint32_t>(std::bit_width(all_bits));
+}
+
+void PackBlock(const std::uint32_t *values, std::uint32_t bits,
+               std::uint32_t *out) {
+  for (std::size_t i = 0; i < PackedBlockWords(bits); ++i) {
+    out[i] = 0;
+  }
+  if (bits == 0) {
+    return;
+  }
+
+  for (std::uint32_t lane = 0; lane < kLaneCount; ++lane) {
+    for (std::uint32_t j = 0; j < kValuesPerLane; ++j) {
+      std::uint64_t value = values[j * kLaneCount + lane];
+      std::uint32_t bit = j * bits;
+      std::uint32_t word = bit / 32;
+      std::uint32_t shift = bit % 32;
+      out[word * kLaneCount + lane] |= static_cast<std::uint32_t>(value << shift);
+      if (shift + bits > 32) {
+        out[(word + 1) * kLaneCount + lane] |=
+            static_cast<std::uint32_t>(value >> (32 - shift));
+      }
+    }
+  }
+}
+
+void UnpackBlock(const std::uint32_t *in, std::uint32_t bits,
+                 std::uint32_t *values) {
+  if (bits == 0) {
+    for (std::uint32_t i = 0; i < kBlockSize; ++i) {
+      values[i] = 0;
+    }
+    return;
+  }
+
+#if SEARCHLIGHT_HAS_X86_SIMD
+  if (GetSimdLevel() != SimdLevel::kScalar) {
+    unpackBlockSse41(in, bits, values);
+    return;
+  }
+#endif
+  unpackBlockScalar(in, bits, values);
+}
+
+void DecodeGaps(std::uint32_t *values, std::size_t count,
+                std::uint32_t first) {
+#if SEARCHLIGHT_HAS_X86_SIMD
+  if (GetSimdLevel() != SimdLevel::kScalar) {
+    decodeGapsSse41(values, count, first);
+    return;
+  }
+#endif
+  decodeGapsScalar(values, count, first);
+}
+
+void AppendVarint(std::string &out, std::uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+} // namespace indexer
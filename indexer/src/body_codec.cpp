@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "body_codec.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+namespace indexer {
+
+namespace {
+
+constexpr std::size_t kKmerSize = 8;
+constexpr std::size_t kSegmentSize = 64;
+// Substrings are counted in a table indexed by their hash; a collision only
+// makes a segment look slightly better than it is.
+constexpr unsigned kCountTableBits = 22;
+
+// Raw deflate, without the zlib header and checksum: the dictionary a body
+// was compressed with is recorded next to it.
+constexpr int kWindowBits = -15;
+constexpr int kMemLevel = 8;
+
+std::uint32_t hashKmer(const char *kmer) {
+  std::uint64_t value;
+  std::memcpy(&value, kmer, sizeof(value));
+  return static_cast<std::uint32_t>((value * 0x9E3779B97F4A7C15ULL) >>
+                                    (64 - kCountTableBits));
+}
+
+} // namespace
+
+std::string TrainDictionary(const std::vector<std::string> &samples,
+                            std::size_t size) {
+  auto getSample = [&](std::size_t index) {
+    return std::string_view(samples[index])
+        .substr(0, kMaxDictionarySampleSize);
+  };
+
+  // Number of samples every substring appears in
+  std::vector<std::uint32_t> sample_counts(std::size_t{1} << kCountTableBits);
+  std::vector<std::uint32_t> last_sample(sample_counts.size(), UINT32_MAX);
+  for (std::uint32_t i = 0; i < samples.size(); ++i) {
+    std::string_view sample = getSample(i);
+    for (std::size_t offset = 0; offset + kKmerSize <= sample.size();
+         ++offset) {
+      std::uint32_t hash = hashKmer(sample.data() + offset);
+      if (last_sample[hash] != i) {
+        last_sample[hash] = i;
+        ++sample_counts[hash];
+      }
+    }
+  }
+
+  // A segment is worth the samples its distinct substrings appear in, as
+  // long as they appear in more than one
+  std::vector<std::uint32_t> hashes;
+  auto getSegmentHashes = [&](std::string_view segment) {
+    hashes.clear();
+    for (std::size_t offset = 0; offset + kKmerSize <= segment.size();
+         ++offset) {
+      hashes.push_back(hashKmer(segment.data() + offset));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+  };
+  auto scoreSegment = [&](std::string_view segment) {
+    getSegmentHashes(segment);
+    std::uint64_t score = 0;
+    for (std::uint32_t hash : hashes) {
+      if (sample_counts[hash] > 1) {
+        score += sample_counts[hash];
+      }
+    }
+    return score;
+  };
+
+  // Candidates overlap by half a segment
+  using Candidate = std::tuple<std::uint64_t, std::uint32_t, std::uint32_t>;
+  std::priority_queue<Candidate> candidates;
+  for (std::uint32_t i = 0; i < samples.size(); ++i) {
+    std::string_view sample = getSample(i);
+    for (std::size_t offset = 0; offset < sample.size();
+         offset += kSegmentSize / 2) {
+      std::uint64_t score = scoreSegment(sample.substr(offset, kSegmentSize));
+      if (score > 0) {
+        candidates.emplace(score, i, static_cast<std::uint32_t>(offset));
+      }
+    }
+  }
+
+  // Scores only go down as segments are picked, so a candidate whose score
+  // is still the best once brought up to date is the best one
+  std::vector<std::string_view> segments;
+  std::size_t dictionary_size = 0;
+  while (!candidates.empty() && dictionary_size < size) {
+    auto [score, sample_index, offset] = candidates.top();
+    candidates.pop();
+    std::string_view segment =
+        getSample(sample_index).substr(offset, kSegmentSize);
+    std::uint64_t current_score = scoreSegment(segment);
+    if (current_score == 0) {
+      continue;
+    }
+    if (!candidates.empty() &&
+        current_score < std::get<0>(candidates.top())) {
+      candidates.emplace(current_score, sample_index, offset);
+      continue;
+    }
+
+    segments.push_back(segment);
+    dictionary_size += segment.size();
+    for (std::uint32_t hash : hashes) {
+      sample_counts[hash] = 0;
+    }
+  }
+
+  std::string dictionary;
+  dictionary.reserve(dictionary_size);
+  for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+    dictionary.append(*it);
+  }
+  if (dictionary.size() > size) {
+    dictionary.erase(0, dictionary.size() - size);
+  }
+  return dictionary;
+}
+
+struct BodyCompressor::Stream {
+  z_stream z{};
+};
+
+BodyCompressor::BodyCompressor(int level) : stream(std::make_unique<Stream>()) {
+  if (deflateInit2(&stream->z, std::clamp(level, 1, 9), Z_DEFLATED,
+                   kWindowBits, kMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Failed to initialize zlib");
+  }
+}
+
+BodyCompressor::~BodyCompressor() { deflateEnd(&stream->z); }
+
+void BodyCompressor::SetDictionary(std::string dictionary) {
+  this->dictionary = std::move(dictionary);
+}
+
+bool BodyCompressor::Compress(std::string_view body, std::string &compressed) {
+  z_stream &z = stream->z;
+  if (deflateReset(&z) != Z_OK) {
+    return false;
+  }
+  if (!dictionary.empty() &&
+      deflateSetDictionary(
+          &z, reinterpret_cast<const Bytef *>(dictionary.data()),
+          static_cast<uInt>(dictionary.size())) != Z_OK) {
+    return false;
+  }
+
+  compressed.resize(deflateBound(&z, static_cast<uLong>(body.size())));
+  z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+  z.avail_in = static_cast<uInt>(body.size());
+  z.next_out = reinterpret_cast<Bytef *>(compressed.data());
+  z.avail_out = static_cast<uInt>(compressed.size());
+  if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+    return false;
+  }
+  compressed.resize(z.total_out);
+  return true;
+}
+
+bool DecompressBody(std::string_view compressed, std::string_view dictionary,
+                    std::size_t size, std::string &body) {
+  z_stream z{};
+  if (inflateInit2(&z, kWindowBits) != Z_OK) {
+    return false;
+  }
+  // A raw stream takes its dictionary up front
+  if (!dictionary.empty() &&
+      inflateSetDictionary(
+          &z, reinterpret_cast<const Bytef *>(dictionary.data()),
+          static_cast<uInt>(dictionary.size())) != Z_OK) {
+    inflateEnd(&z);
+    return false;
+  }
+
+  body.resize(size);
+  z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  z.avail_in = static_cast<uInt>(compressed.size());
+  z.next_out = reinterpret_cast<Bytef *>(body.data());
+  z.avail_out = static_cast<uInt>(body.size());
+  int result = inflate(&z, Z_FINISH);
+  bool is_complete = result == Z_STREAM_END && z.total_out == size;
+  inflateEnd(&z);
+  return is_complete;
+}
+
+} // namespace indexer
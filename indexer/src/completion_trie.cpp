@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "completion_trie.hpp"
+
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+
+namespace indexer {
+
+CompletionTrie::CompletionTrie(const std::string &path) : file(path) {
+  header = reinterpret_cast<const CompletionHeader *>(file.GetData());
+  validate(path);
+  nodes = reinterpret_cast<const CompletionNode *>(file.GetData() +
+                                                   header->nodes_offset);
+  labels = reinterpret_cast<const char *>(file.GetData() +
+                                          header->labels_offset);
+}
+
+std::uint64_t CompletionTrie::GetTermCount() const {
+  return header->term_count;
+}
+
+std::uint64_t CompletionTrie::GetSourceGeneration() const {
+  return header->source_generation;
+}
+
+std::vector<Completion> CompletionTrie::Complete(std::string_view prefix,
+                                                 std::size_t k) const {
+  std::vector<Completion> completions;
+  if (k == 0) {
+    return completions;
+  }
+
+  // Follow the prefix down to the node whose subtree holds every term
+  // starting with it. The prefix may end in the middle of that node's label.
+  const CompletionNode *node = &nodes[0];
+  std::string path;
+  while (path.size() < prefix.size()) {
+    node = findChild(*node, prefix[path.size()]);
+    if (!node) {
+      return completions;
+    }
+    std::string_view label = getLabel(*node);
+    std::string_view rest = prefix.substr(path.size());
+    if (label.substr(0, rest.size()) != rest.substr(0, label.size())) {
+      return completions;
+    }
+    path += label;
+  }
+
+  // Best-first search: an entry is either a subtree, ranked by the highest
+  // weight in it, or a term, ranked by its weight. A term comes out before
+  // any subtree that could hold a better one, so the first k terms out are
+  // the best. Every term of a subtree sorts after its path, so breaking ties
+  // on the text keeps equal weights in sorted order.
+  struct Entry {
+    std::uint32_t priority;
+    bool is_term;
+    std::uint32_t node;
+    std::string text;
+  };
+  auto is_worse = [](const Entry &a, const Entry &b) {
+    if (a.priority != b.priority) {
+      return a.priority < b.priority;
+    }
+    if (a.text != b.text) {
+      return a.text > b.text;
+    }
+    return b.is_term;
+  };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(is_worse)> queue(
+      is_worse);
+  queue.push({node->max_weight, false,
+              static_cast<std::uint32_t>(node - nodes), std::move(path)});
+
+  while (!queue.empty() && completions.size() < k) {
+    Entry entry = queue.top();
+    queue.pop();
+    if (entry.is_term) {
+      completions.push_back({std::move(entry.text), entry.priority});
+      continue;
+    }
+
+    const CompletionNode &current = nodes[entry.node];
+    if (current.weight > 0) {
+      queue.push({current.weight, true, entry.node, entry.text});
+    }
+    for (std::uint32_t i = 0; i < current.child_count; ++i) {
+      std::uint32_t child_index = current.first_child + i;
+      const CompletionNode &child = nodes[child_index];
+      queue.push({child.max_weight, false, child_index,
+                  entry.text + std::string(getLabel(child))});
+    }
+  }
+  return completions;
+}
+
+// Private methods
+
+std::string_view CompletionTrie::getLabel(const CompletionNode &node) const {
+  return {labels + node.label_offset, node.label_length};
+}
+
+const CompletionNode *CompletionTrie::findChild(const CompletionNode &node,
+                                                char c) const {
+  // Children are sorted by the first byte of their label
+  const CompletionNode *low = nodes + node.first_child;
+  const CompletionNode *high = low + node.child_count;
+  while (low < high) {
+    const CompletionNode *middle = low + (high - low) / 2;
+    auto first = static_cast<unsigned char>(labels[middle->label_offset]);
+    if (first == static_cast<unsigned char>(c)) {
+      return middle;
+    }
+    if (first < static_cast<unsigned char>(c)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return nullptr;
+}
+
+void CompletionTrie::validate(const std::string &path) const {
+  std::size_t size = file.GetSize();
+  if (size < sizeof(CompletionHeader)) {
+    throw std::runtime_error("Invalid completion trie: " + path);
+  }
+  if (std::memcmp(header->magic, kCompletionMagic, sizeof(kCompletionMagic)) !=
+      0) {
+    throw std::runtime_error("Not a completion trie: " + path);
+  }
+  if (header->version != kCompletionVersion) {
+    throw std::runtime_error("Unsupported completion trie version " +
+                             std::to_string(header->version) + ": " + path);
+  }
+
+  // As with segments, the nodes themselves are trusted, as tries are only
+  // written by CompletionWriter
+  if (header->file_size != size || header->node_count == 0 ||
+      header->nodes_offset > size ||
+      header->node_count > (size - header->nodes_offset) /
+                               sizeof(CompletionNode) ||
+      header->labels_offset > size) {
+    throw std::runtime_error("Truncated or corrupted completion trie: " +
+                             path);
+  }
+}
+
+} // namespace indexer
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "completion_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "mapped_file.hpp"
+
+namespace indexer {
+
+bool CompletionWriter::AddTerm(std::string_view term, std::uint32_t weight) {
+  if (term.empty() || term.size() > UINT8_MAX ||
+      (!terms.empty() && term <= terms.back().text)) {
+    return false;
+  }
+  if (weight > 0) {
+    terms.push_back({std::string(term), weight});
+  }
+  return true;
+}
+
+std::size_t CompletionWriter::GetTermCount() const { return terms.size(); }
+
+bool CompletionWriter::Write(const std::string &path,
+                             std::uint64_t source_generation) const {
+  std::vector<CompletionNode> nodes(1, CompletionNode{});
+  std::string labels;
+  nodes[0].max_weight = buildChildren(0, terms.size(), 0, 0, nodes, labels);
+  if (nodes.size() > UINT32_MAX || labels.size() > UINT32_MAX) {
+    std::cerr << "Vocabulary is too large for a completion trie" << std::endl;
+    return false;
+  }
+
+  CompletionHeader header{};
+  std::memcpy(header.magic, kCompletionMagic, sizeof(kCompletionMagic));
+  header.version = kCompletionVersion;
+  header.node_count = static_cast<std::uint32_t>(nodes.size());
+  header.term_count = terms.size();
+  header.source_generation = source_generation;
+  header.nodes_offset = sizeof(CompletionHeader);
+  header.labels_offset =
+      header.nodes_offset + nodes.size() * sizeof(CompletionNode);
+  header.file_size = header.labels_offset + labels.size();
+
+  std::string data;
+  data.reserve(header.file_size);
+  data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  data.append(reinterpret_cast<const char *>(nodes.data()),
+              nodes.size() * sizeof(CompletionNode));
+  data.append(labels);
+
+  if (!WriteFileAtomically(path, data)) {
+    std::cerr << "Failed to write completion file: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Private methods
+
+std::uint32_t CompletionWriter::buildChildren(
+    std::size_t begin, std::size_t end, std::size_t depth, std::size_t parent,
+    std::vector<CompletionNode> &nodes, std::string &labels) const {
+  // Children are laid out next to each other before any of them gets its
+  // own children, so each group is found first
+  std::vector<std::pair<std::size_t, std::size_t>> groups;
+  for (std::size_t i = begin; i < end;) {
+    std::size_t group_end = i + 1;
+    while (group_end < end &&
+           terms[group_end].text[depth] == terms[i].text[depth]) {
+      ++group_end;
+    }
+    groups.emplace_back(i, group_end);
+    i = group_end;
+  }
+
+  std::size_t first_child = nodes.size();
+  nodes[parent].first_child = static_cast<std::uint32_t>(first_child);
+  nodes[parent].child_count = static_cast<std::uint16_t>(groups.size());
+  nodes.resize(nodes.size() + groups.size());
+
+  std::uint32_t max_weight = 0;
+  for (std::size_t g = 0; g < groups.size(); ++g) {
+    auto [group_begin, group_end] = groups[g];
+    const std::string &first = terms[group_begin].text;
+    const std::string &last = terms[group_end - 1].text;
+
+    // The label runs to the longest prefix the group shares. Terms are
+    // sorted, so that is the one the first and last terms share, and a
+    // term ending there is the first one.
+    std::size_t shared_length = depth + 1;
+    while (shared_length < first.size() && shared_length < last.size() &&
+           first[shared_length] == last[shared_length]) {
+      ++shared_length;
+    }
+
+    std::size_t node = first_child + g;
+    nodes[node].label_offset = static_cast<std::uint32_t>(labels.size());
+    nodes[node].label_length =
+        static_cast<std::uint8_t>(shared_length - depth);
+    labels.append(first, depth, shared_length - depth);
+
+    std::size_t children_begin = group_begin;
+    if (first.size() == shared_length) {
+      nodes[node].weight = terms[group_begin].weight;
+      ++children_begin;
+    }
+    std::uint32_t node_max_weight = nodes[node].weight;
+    if (children_begin < group_end) {
+      node_max_weight = std::max(
+          node_max_weight, buildChildren(children_begin, group_end,
+                                         shared_length, node, nodes, labels));
+    }
+    nodes[node].max_weight = node_max_weight;
+    max_weight = std::max(max_weight, node_max_weight);
+  }
+  return max_weight;
+}
+
+} // namespace indexer
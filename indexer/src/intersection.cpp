@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "intersection.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include "simd.hpp"
+
+#if SEARCHLIGHT_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace indexer {
+
+namespace {
+
+// Lists this many times longer than the other one are searched rather than
+// merged
+constexpr std::size_t kLookupRatio = 16;
+
+// Doubles the step from `from` until a value at least `target` is in reach,
+// then halves the range it is in until it is at most `width` values long.
+std::pair<std::size_t, std::size_t> gallop(const std::uint32_t *values,
+                                           std::size_t count, std::size_t from,
+                                           std::size_t width,
+                                           std::uint32_t target) {
+  std::size_t step = width;
+  while (from + step < count && values[from + step - 1] < target) {
+    from += step;
+    step *= 2;
+  }
+  std::size_t end = std::min(from + step, count);
+  while (end - from > width) {
+    std::size_t middle = from + (end - from) / 2;
+    if (values[middle - 1] < target) {
+      from = middle;
+    } else {
+      end = middle;
+    }
+  }
+  return {from, end};
+}
+
+std::size_t lowerBoundScalar(const std::uint32_t *values, std::size_t count,
+                             std::size_t from, std::uint32_t target) {
+  auto [begin, end] = gallop(values, count, from, 1, target);
+  return std::lower_bound(values + begin, values + end, target) - values;
+}
+
+std::size_t mergeScalar(const std::uint32_t *a, std::size_t a_count,
+                        const std::uint32_t *b, std::size_t b_count,
+                        std::uint32_t *out) {
+  std::size_t out_count = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i < a_count && j < b_count) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (b[j] < a[i]) {
+      ++j;
+    } else {
+      out[out_count++] = a[i];
+      ++i;
+      ++j;
+    }
+  }
+  return out_count;
+}
+
+#if SEARCHLIGHT_HAS_X86_SIMD
+
+// The last vector of values is compared at once instead of searched.
+// Values are compared unsigned: a value is at least the target when their
+// maximum is the value itself. Since the values are sorted, the number
+// below the target is the offset of the first one that is not.
+__attribute__((target("sse4.1"))) std::size_t
+lowerBoundSse41(const std::uint32_t *values, std::size_t count,
+                std::size_t from, std::uint32_t target) {
+  auto [begin, end] = gallop(values, count, from, 4, target);
+  if (end - begin < 4) {
+    return std::lower_bound(values + begin, values + end, target) - values;
+  }
+  __m128i chunk =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + begin));
+  __m128i targets = _mm_set1_epi32(static_cast<int>(target));
+  __m128i is_at_least = _mm_cmpeq_epi32(_mm_max_epu32(chunk, targets), chunk);
+  int mask = _mm_movemask_ps(_mm_castsi128_ps(is_at_least));
+  return begin + 4 - std::popcount(static_cast<unsigned>(mask));
+}
+
+__attribute__((target("avx2"))) std::size_t
+lowerBoundAvx2(const std::uint32_t *values, std::size_t count,
+               std::size_t from, std::uint32_t target) {
+  auto [begin, end] = gallop(values, count, from, 8, target);
+  if (end - begin < 8) {
+    return std::lower_bound(values + begin, values + end, target) - values;
+  }
+  __m256i chunk =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + begin));
+  __m256i targets = _mm256_set1_epi32(static_cast<int>(target));
+  __m256i is_at_least =
+      _mm256_cmpeq_epi32(_mm256_max_epu32(chunk, targets), chunk);
+  int mask = _mm256_movemask_ps(_mm256_castsi256_ps(is_at_least));
+  return begin + 8 - std::popcount(static_cast<unsigned>(mask));
+}
+
+// Writes the values of `a` whose bits are set in `mask`.
+std::size_t emitMatches(const std::uint32_t *a, unsigned mask,
+                        std::uint32_t *out) {
+  std::size_t out_count = 0;
+  while (mask != 0) {
+    out[out_count++] = a[std::countr_zero(mask)];
+    mask &= mask - 1;
+  }
+  return out_count;
+}
+
+// Compares a vector of each list against every rotation of the other one,
+// so that all pairs are compared at once, then moves past the vector that
+// ends first (or both). Whatever is left over is merged one by one.
+__attribute__((target("sse4.1"))) std::size_t
+mergeSse41(const std::uint32_t *a, std::size_t a_count,
+           const std::uint32_t *b, std::size_t b_count, std::uint32_t *out) {
+  std::size_t out_count = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i + 4 <= a_count && j + 4 <= b_count) {
+    __m128i a_values =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i b_values =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+    __m128i matches = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(a_values, b_values),
+                     _mm_cmpeq_epi32(a_values,
+                                     _mm_shuffle_epi32(b_values, 0x39))),
+        _mm_or_si128(
+            _mm_cmpeq_epi32(a_values, _mm_shuffle_epi32(b_values, 0x4E)),
+            _mm_cmpeq_epi32(a_values, _mm_shuffle_epi32(b_values, 0x93))));
+    out_count += emitMatches(
+        a + i,
+        static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(matches))),
+        out + out_count);
+
+    std::uint32_t a_last = a[i + 3];
+    std::uint32_t b_last = b[j + 3];
+    i += a_last <= b_last ? 4 : 0;
+    j += b_last <= a_last ? 4 : 0;
+  }
+  return out_count +
+         mergeScalar(a + i, a_count - i, b + j, b_count - j, out + out_count);
+}
+
+// As mergeSse41, with 8 values, rotated across the whole 256-bit vector.
+__attribute__((target("avx2"))) std::size_t
+mergeAvx2(const std::uint32_t *a, std::size_t a_count, const std::uint32_t *b,
+          std::size_t b_count, std::uint32_t *out) {
+  const __m256i rotate_1 = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  const __m256i rotate_2 = _mm256_setr_epi32(2, 3, 4, 5, 6, 7, 0, 1);
+  const __m256i rotate_3 = _mm256_setr_epi32(3, 4, 5, 6, 7, 0, 1, 2);
+  const __m256i rotate_4 = _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3);
+  std::size_t out_count = 0;
+  std::size_t i = 0;
+  std::size_t j = 0;
+  while (i + 8 <= a_count && j + 8 <= b_count) {
+    __m256i a_values =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i b_values =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+    __m256i b_values_4 = _mm256_permutevar8x32_epi32(b_values, rotate_4);
+    __m256i matches_0 = _mm256_or_si256(
+        _mm256_cmpeq_epi32(a_values, b_values),
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values, rotate_1)));
+    __m256i matches_1 = _mm256_or_si256(
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values, rotate_2)),
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values, rotate_3)));
+    __m256i matches_2 = _mm256_or_si256(
+        _mm256_cmpeq_epi32(a_values, b_values_4),
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values_4, rotate_1)));
+    __m256i matches_3 = _mm256_or_si256(
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values_4, rotate_2)),
+        _mm256_cmpeq_epi32(a_values,
+                           _mm256_permutevar8x32_epi32(b_values_4, rotate_3)));
+    __m256i matches = _mm256_or_si256(_mm256_or_si256(matches_0, matches_1),
+                                      _mm256_or_si256(matches_2, matches_3));
+    out_count += emitMatches(
+        a + i,
+        static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(matches))),
+        out + out_count);
+
+    std::uint32_t a_last = a[i + 7];
+    std::uint32_t b_last = b[j + 7];
+    i += a_last <= b_last ? 8 : 0;
+    j += b_last <= a_last ? 8 : 0;
+  }
+  return out_count +
+         mergeScalar(a + i, a_count - i, b + j, b_count - j, out + out_count);
+}
+
+#endif
+
+// Looks every value of the shorter list up in the longer one.
+std::size_t intersectByLookup(const std::uint32_t *a, std::size_t a_count,
+                              const std::uint32_t *b, std::size_t b_count,
+                              std::uint32_t *out) {
+  std::size_t out_count = 0;
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < a_count && j < b_count; ++i) {
+    j = LowerBound(b, b_count, j, a[i]);
+    if (j < b_count && b[j] == a[i]) {
+      out[out_count++] = a[i];
+    }
+  }
+  return out_count;
+}
+
+} // namespace
+
+std::size_t LowerBound(const std::uint32_t *values, std::size_t count,
+                       std::size_t from, std::uint32_t target) {
+  // Most lookups of a conjunction land on the document they start from
+  if (from >= count || values[from] >= target) {
+    return from;
+  }
+
+  switch (GetSimdLevel()) {
+#if SEARCHLIGHT_HAS_X86_SIMD
+  case SimdLevel::kAvx2:
+    return lowerBoundAvx2(values, count, from, target);
+  case SimdLevel::kSse41:
+    return lowerBoundSse41(values, count, from, target);
+#endif
+  default:
+    return lowerBoundScalar(values, count, from, target);
+  }
+}
+
+std::size_t IntersectSorted(const std::uint32_t *a, std::size_t a_count,
+                            const std::uint32_t *b, std::size_t b_count,
+                            std::uint32_t *out) {
+  if (a_count > b_count) {
+    std::swap(a, b);
+    std::swap(a_count, b_count);
+  }
+  if (a_count * kLookupRatio < b_count) {
+    return intersectByLookup(a, a_count, b, b_count, out);
+  }
+
+  switch (GetSimdLevel()) {
+#if SEARCHLIGHT_HAS_X86_SIMD
+  case SimdLevel::kAvx2:
+    return mergeAvx2(a, a_count, b, b_count, out);
+  case SimdLevel::kSse41:
+    return mergeSse41(a, a_count, b, b_count, out);
+#endif
+  default:
+    return mergeScalar(a, a_count, b, b_count, out);
+  }
+}
+
+} // namespace indexer
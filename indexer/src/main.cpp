@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include <sqlite3.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "body_codec.hpp"
+#include "completion_writer.hpp"
+#include "config.hpp"
+#include "segment.hpp"
+#include "segment_writer.hpp"
+#include "tokenizer.hpp"
+
+namespace {
+
+std::string_view getColumnText(sqlite3_stmt *stmt, int column) {
+  const auto *text =
+      reinterpret_cast<const char *>(sqlite3_column_text(stmt, column));
+  if (!text) {
+    return {};
+  }
+  return {text, static_cast<std::size_t>(sqlite3_column_bytes(stmt, column))};
+}
+
+// Pages are re-indexed from their markup, which the crawler stores
+// compressed next to the text it gives the FTS table. Pages stored before
+// it did only have their markup in the content column.
+constexpr const char *kPagesWithBodiesQuery =
+    "SELECT webpages.url, webpages.title, webpages.content, "
+    "webpage_bodies.dictionary_id, webpage_bodies.size, webpage_bodies.body "
+    "FROM webpages LEFT JOIN webpage_bodies USING (url);";
+constexpr const char *kPagesQuery = "SELECT url, title, content FROM webpages;";
+
+std::string_view getColumnBlob(sqlite3_stmt *stmt, int column) {
+  const auto *blob =
+      static_cast<const char *>(sqlite3_column_blob(stmt, column));
+  if (!blob) {
+    return {};
+  }
+  return {blob, static_cast<std::size_t>(sqlite3_column_bytes(stmt, column))};
+}
+
+// Returns the dictionaries page bodies are compressed with, by id.
+std::unordered_map<std::int64_t, std::string> loadDictionaries(sqlite3 *db) {
+  std::unordered_map<std::int64_t, std::string> dictionaries;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT id, dictionary FROM body_dictionaries;",
+                         -1, &stmt, nullptr) != SQLITE_OK) {
+    return dictionaries;
+  }
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    dictionaries.emplace(sqlite3_column_int64(stmt, 0),
+                         std::string(getColumnBlob(stmt, 1)));
+  }
+  sqlite3_finalize(stmt);
+  return dictionaries;
+}
+
+// Returns the markup of the page in the current row, decompressing its body
+// into `body` if it has one.
+std::string_view getPageHtml(
+    sqlite3_stmt *stmt, bool has_bodies,
+    const std::unordered_map<std::int64_t, std::string> &dictionaries,
+    std::string &body) {
+  if (!has_bodies || sqlite3_column_type(stmt, 5) == SQLITE_NULL) {
+    return getColumnText(stmt, 2);
+  }
+
+  std::string_view dictionary;
+  if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+    auto it = dictionaries.find(sqlite3_column_int64(stmt, 3));
+    if (it == dictionaries.end()) {
+      std::cerr << "Missing dictionary for " << getColumnText(stmt, 0)
+                << std::endl;
+      return getColumnText(stmt, 2);
+    }
+    dictionary = it->second;
+  }
+  if (!indexer::DecompressBody(
+          getColumnBlob(stmt, 5), dictionary,
+          static_cast<std::size_t>(sqlite3_column_int64(stmt, 4)), body)) {
+    std::cerr << "Corrupted body for " << getColumnText(stmt, 0) << std::endl;
+    return getColumnText(stmt, 2);
+  }
+  return body;
+}
+
+bool fail(sqlite3 *db, const std::string &message) {
+  std::cerr << message << ": " << sqlite3_errmsg(db) << std::endl;
+  sqlite3_close(db);
+  return false;
+}
+
+// Reads every page in one read transaction, so that the segment matches the
+// generation it is tagged with.
+bool buildSegment(indexer::SegmentWriter &segment_writer,
+                  std::uint64_t &generation) {
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(DB_PATH, &db, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    return fail(db, "Failed to open SQLite database");
+  }
+
+  // The FTS table cannot be read without its tokenizer
+  sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, nullptr);
+  if (sqlite3_load_extension(db, FTS_HTML_EXT_PATH, nullptr, nullptr) !=
+      SQLITE_OK) {
+    return fail(db, "Failed to load FTS HTML extension");
+  }
+  sqlite3_busy_timeout(db, 5000);
+
+  if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    return fail(db, "Failed to begin SQLite transaction");
+  }
+
+  generation = 0;
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db,
+                         "SELECT generation FROM index_generation WHERE id = 0;",
+                         -1, &stmt, nullptr) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      generation = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  std::unordered_map<std::int64_t, std::string> dictionaries =
+      loadDictionaries(db);
+  bool has_bodies = sqlite3_prepare_v2(db, kPagesWithBodiesQuery, -1, &stmt,
+                                       nullptr) == SQLITE_OK;
+  if (!has_bodies &&
+      sqlite3_prepare_v2(db, kPagesQuery, -1, &stmt, nullptr) != SQLITE_OK) {
+    return fail(db, "Failed to prepare SQLite statement");
+  }
+
+  int result;
+  std::string body;
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    std::string_view html = getPageHtml(stmt, has_bodies, dictionaries, body);
+    segment_writer.AddDocument(getColumnText(stmt, 0), getColumnText(stmt, 1),
+                               indexer::ExtractText(html));
+    if (segment_writer.GetDocCount() % 10000 == 0) {
+      std::cout << "Indexed " << segment_writer.GetDocCount() << " pages"
+                << std::endl;
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (result != SQLITE_DONE) {
+    return fail(db, "Failed to read pages");
+  }
+
+  sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+  sqlite3_close(db);
+  return true;
+}
+
+// Builds the completion trie from the vocabulary of the segment just written,
+// weighting every term by the number of pages it appears in.
+bool buildCompletions(const std::string &segment_path,
+                      const std::string &completion_path) {
+  try {
+    indexer::Segment segment(segment_path);
+    indexer::CompletionWriter completion_writer;
+    for (std::uint64_t i = 0; i < segment.GetTermCount(); ++i) {
+      const indexer::TermEntry &term_entry = segment.GetTermEntry(i);
+      completion_writer.AddTerm(segment.GetTerm(term_entry),
+                                term_entry.doc_freq);
+    }
+    return completion_writer.Write(completion_path,
+                                   segment.GetSourceGeneration());
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+}
+
+} // namespace
+
+int main() {
+  auto start_time = std::chrono::steady_clock::now();
+
+  indexer::SegmentWriter segment_writer;
+  std::uint64_t generation;
+  if (!buildSegment(segment_writer, generation)) {
+    return 1;
+  }
+
+  const std::string segment_path = std::string(INDEX_PATH) + "/webpages.seg";
+  if (!segment_writer.Write(segment_path, generation)) {
+    return 1;
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  std::cout << "Wrote " << segment_path << ": "
+            << segment_writer.GetDocCount() << " pages, "
+            << segment_writer.GetTermCount() << " terms, generation "
+            << generation << ", in " << elapsed.count() << " ms" << std::endl;
+
+  const std::string completion_path = std::string(INDEX_PATH) + "/webpages.sug";
+  if (!buildCompletions(segment_path, completion_path)) {
+    return 1;
+  }
+  std::cout << "Wrote " << completion_path << std::endl;
+  return 0;
+}
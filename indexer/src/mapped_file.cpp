@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace indexer {
+
+namespace {
+
+bool writeAll(int fd, std::string_view data) {
+  const char *next = data.data();
+  std::size_t remaining = data.size();
+  while (remaining > 0) {
+    ssize_t written = ::write(fd, next, remaining);
+    if (written < 0) {
+      return false;
+    }
+    next += written;
+    remaining -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("Empty or unreadable file: " + path);
+  }
+  size = static_cast<std::size_t>(file_stat.st_size);
+
+  // The mapping stays valid after the descriptor is closed
+  void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  data = static_cast<const std::uint8_t *>(mapping);
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    ::munmap(const_cast<std::uint8_t *>(data), size);
+  }
+}
+
+const std::uint8_t *MappedFile::GetData() const { return data; }
+
+std::size_t MappedFile::GetSize() const { return size; }
+
+bool WriteFileAtomically(const std::string &path, std::string_view data) {
+  std::string temp_path = path + ".tmp";
+  int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool is_written = writeAll(fd, data) && ::fsync(fd) == 0;
+  is_written = ::close(fd) == 0 && is_written;
+  if (!is_written || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    ::unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace indexer
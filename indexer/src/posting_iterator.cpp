@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "posting_iterator.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bit_packing.hpp"
+#include "intersection.hpp"
+
+namespace indexer {
+
+PostingIterator::PostingIterator(const Segment &segment,
+                                 const TermEntry &term_entry)
+    : doc_freq(term_entry.doc_freq),
+      block_count((term_entry.doc_freq + kBlockSize - 1) / kBlockSize),
+      max_freq(term_entry.max_freq), min_doc_length(term_entry.min_doc_length) {
+  const std::uint8_t *postings = segment.GetData(term_entry.postings_offset);
+  skip_entries = reinterpret_cast<const SkipEntry *>(postings);
+  blocks = postings + block_count * sizeof(SkipEntry);
+  positions = segment.GetData(term_entry.positions_offset);
+
+  if (block_count > 0) {
+    loadBlock(0);
+    doc = docs[0];
+  }
+}
+
+std::uint32_t PostingIterator::GetDoc() const { return doc; }
+
+std::uint32_t PostingIterator::GetFreq() const {
+  return freqs[index_in_block];
+}
+
+std::uint32_t PostingIterator::GetDocFreq() const { return doc_freq; }
+
+std::uint32_t PostingIterator::GetMaxFreq() const { return max_freq; }
+
+std::uint32_t PostingIterator::GetMinDocLength() const {
+  return min_doc_length;
+}
+
+std::uint32_t PostingIterator::Next() {
+  if (doc == kEnd) {
+    return kEnd;
+  }
+  if (++index_in_block == block_doc_count) {
+    if (block + 1 == block_count) {
+      doc = kEnd;
+      return kEnd;
+    }
+    loadBlock(block + 1);
+  }
+  doc = docs[index_in_block];
+  return doc;
+}
+
+std::uint32_t PostingIterator::Advance(std::uint32_t target) {
+  if (doc >= target) {
+    return doc;
+  }
+
+  if (skip_entries[block].last_doc < target) {
+    if (!ShallowAdvance(target)) {
+      doc = kEnd;
+      return kEnd;
+    }
+    loadBlock(shallow_block);
+  }
+
+  // The block ends at or after the target, so this stops inside it
+  index_in_block = static_cast<std::uint32_t>(
+      LowerBound(docs, block_doc_count, index_in_block, target));
+  doc = docs[index_in_block];
+  return doc;
+}
+
+void PostingIterator::GetPositions(std::vector<std::uint32_t> &positions) {
+  positions.clear();
+  if (doc == kEnd) {
+    return;
+  }
+
+  std::uint32_t value;
+  while (positions_cursor_index < index_in_block) {
+    for (std::uint32_t i = 0; i < freqs[positions_cursor_index]; ++i) {
+      positions_cursor = ReadVarint(positions_cursor, value);
+    }
+    ++positions_cursor_index;
+  }
+
+  const std::uint8_t *cursor = positions_cursor;
+  std::uint32_t position = 0;
+  for (std::uint32_t i = 0; i < freqs[index_in_block]; ++i) {
+    cursor = ReadVarint(cursor, value);
+    position += value;
+    positions.push_back(position);
+  }
+}
+
+const SkipEntry *PostingIterator::ShallowAdvance(std::uint32_t target) {
+  while (shallow_block < block_count &&
+         skip_entries[shallow_block].last_doc < target) {
+    ++shallow_block;
+  }
+  return shallow_block < block_count ? &skip_entries[shallow_block] : nullptr;
+}
+
+// Private methods
+
+void PostingIterator::loadBlock(std::uint32_t block) {
+  this->block = block;
+  shallow_block = std::max(shallow_block, block);
+  block_doc_count = block + 1 == block_count
+                        ? doc_freq - block * kBlockSize
+                        : kBlockSize;
+  index_in_block = 0;
+  positions_cursor = positions + skip_entries[block].positions_offset;
+  positions_cursor_index = 0;
+
+  const std::uint8_t *block_data = blocks + skip_entries[block].block_offset;
+  if (block_doc_count == kBlockSize) {
+    std::uint32_t bit_widths;
+    std::memcpy(&bit_widths, block_data, sizeof(bit_widths));
+    std::uint32_t gap_bits = bit_widths & 0xFF;
+    std::uint32_t freq_bits = (bit_widths >> 8) & 0xFF;
+    const auto *words = reinterpret_cast<const std::uint32_t *>(block_data) + 1;
+    UnpackBlock(words, gap_bits, docs);
+    UnpackBlock(words + PackedBlockWords(gap_bits), freq_bits, freqs);
+  } else {
+    for (std::uint32_t i = 0; i < block_doc_count; ++i) {
+      block_data = ReadVarint(block_data, docs[i]);
+    }
+    for (std::uint32_t i = 0; i < block_doc_count; ++i) {
+      block_data = ReadVarint(block_data, freqs[i]);
+    }
+  }
+
+  // Turn gaps into document ids, and stored frequencies back into counts
+  DecodeGaps(docs, block_doc_count,
+             block == 0 ? 0 : skip_entries[block - 1].last_doc + 1);
+  for (std::uint32_t i = 0; i < block_doc_count; ++i) {
+    ++freqs[i];
+  }
+}
+
+} // namespace indexer
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "query.hpp"
+
+#include "tokenizer.hpp"
+
+namespace indexer {
+
+namespace {
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+} // namespace
+
+Query Query::Parse(std::string_view text) {
+  Query query;
+  std::size_t i = 0;
+  while (i < text.size()) {
+    if (text[i] == '"') {
+      std::size_t end = text.find('"', i + 1);
+      if (end == std::string_view::npos) {
+        end = text.size();
+      }
+
+      std::vector<std::string> phrase;
+      ForEachToken(text.substr(i + 1, end - i - 1), [&](std::string_view token) {
+        phrase.emplace_back(token);
+      });
+      // A quoted single word is kept as a phrase too, to make it required
+      if (!phrase.empty()) {
+        query.phrases.push_back(std::move(phrase));
+      }
+      i = end + 1;
+      continue;
+    }
+
+    std::size_t end = i;
+    while (end < text.size() && !isSpace(text[end]) && text[end] != '"') {
+      ++end;
+    }
+    std::string_view word = text.substr(i, end - i);
+    if (word == "OR") {
+      query.is_disjunction = true;
+    } else {
+      ForEachToken(word, [&](std::string_view token) {
+        query.terms.emplace_back(token);
+      });
+    }
+    i = end == i ? i + 1 : end;
+  }
+  return query;
+}
+
+bool Query::IsEmpty() const { return terms.empty() && phrases.empty(); }
+
+} // namespace indexer
@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "searcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+
+#include "intersection.hpp"
+#include "posting_iterator.hpp"
+
+namespace indexer {
+
+namespace {
+
+constexpr std::uint32_t kEnd = PostingIterator::kEnd;
+
+struct TermCursor {
+  PostingIterator postings;
+  float idf;
+  // Bound of the score of the term in any document
+  float max_score;
+  bool is_required;
+};
+
+bool isBetter(const ScoredDoc &a, const ScoredDoc &b) {
+  return a.score != b.score ? a.score > b.score : a.doc_id < b.doc_id;
+}
+
+// The k best documents seen so far, in a min-heap on score
+class TopDocs {
+public:
+  TopDocs(std::size_t k, std::optional<ScoredDoc> after) : k(k), after(after) {
+    heap.reserve(k);
+  }
+
+  bool IsFull() const { return heap.size() == k; }
+
+  // Score a document must beat to get in
+  float GetThreshold() const { return IsFull() ? heap.front().score : 0.0f; }
+
+  // Returns false for documents on pages before the one being searched
+  bool IsAfterCursor(std::uint32_t doc_id, float score) const {
+    return !after || isBetter(*after, {doc_id, score});
+  }
+
+  void Push(std::uint32_t doc_id, float score) {
+    if (!IsAfterCursor(doc_id, score)) {
+      return;
+    }
+    if (!IsFull()) {
+      heap.push_back({doc_id, score});
+      std::push_heap(heap.begin(), heap.end(), isBetter);
+    } else if (score > heap.front().score) {
+      std::pop_heap(heap.begin(), heap.end(), isBetter);
+      heap.back() = {doc_id, score};
+      std::push_heap(heap.begin(), heap.end(), isBetter);
+    }
+  }
+
+  std::vector<ScoredDoc> TakeSorted() {
+    std::sort(heap.begin(), heap.end(), isBetter);
+    return std::move(heap);
+  }
+
+private:
+  std::size_t k;
+  std::optional<ScoredDoc> after;
+  std::vector<ScoredDoc> heap;
+};
+
+class QueryEvaluator {
+public:
+  QueryEvaluator(const Searcher &searcher, const Segment &segment,
+                 std::vector<TermCursor> &cursors,
+                 const std::vector<std::vector<std::size_t>> &phrases,
+                 std::size_t k, std::optional<ScoredDoc> after)
+      : searcher(searcher), segment(segment), cursors(cursors),
+        phrases(phrases), top_docs(k, after) {}
+
+  std::vector<ScoredDoc> Evaluate() {
+    bool has_required = std::any_of(
+        cursors.begin(), cursors.end(),
+        [](const TermCursor &cursor) { return cursor.is_required; });
+    if (has_required) {
+      evaluateConjunction();
+    } else {
+      evaluateDisjunction();
+    }
+    return top_docs.TakeSorted();
+  }
+
+private:
+  const Searcher &searcher;
+  const Segment &segment;
+  std::vector<TermCursor> &cursors;
+  const std::vector<std::vector<std::size_t>> &phrases;
+  TopDocs top_docs;
+  std::vector<std::uint32_t> positions;
+  std::vector<std::uint32_t> other_positions;
+  std::vector<std::uint32_t> matched_positions;
+
+  float getBlockBound(const TermCursor &cursor, const SkipEntry &block) const {
+    return searcher.Score(cursor.idf, block.max_freq, block.min_doc_length);
+  }
+
+  float getScore(const TermCursor &cursor, std::uint32_t doc_length) const {
+    return searcher.Score(cursor.idf, cursor.postings.GetFreq(), doc_length);
+  }
+
+  // Walks the rarest required term and looks the other terms up in its
+  // documents. Before looking at a document, the bounds of the blocks it
+  // falls in are summed; if they cannot beat the threshold, every document
+  // up to the end of the first of those blocks is skipped.
+  void evaluateConjunction() {
+    std::vector<TermCursor *> required;
+    std::vector<TermCursor *> optional;
+    for (TermCursor &cursor : cursors) {
+      (cursor.is_required ? required : optional).push_back(&cursor);
+    }
+    std::sort(required.begin(), required.end(),
+              [](const TermCursor *a, const TermCursor *b) {
+                return a->postings.GetDocFreq() < b->postings.GetDocFreq();
+              });
+
+    PostingIterator &lead = required.front()->postings;
+    std::uint32_t doc = lead.GetDoc();
+    while (doc != kEnd) {
+      if (top_docs.IsFull()) {
+        float bound = 0.0f;
+        std::uint32_t bound_end = kEnd;
+        bool is_exhausted = false;
+        for (TermCursor &cursor : cursors) {
+          const SkipEntry *block = cursor.postings.ShallowAdvance(doc);
+          if (!block) {
+            is_exhausted = is_exhausted || cursor.is_required;
+            continue;
+          }
+          bound += getBlockBound(cursor, *block);
+          bound_end = std::min(bound_end, block->last_doc);
+        }
+        if (is_exhausted) {
+          break;
+        }
+        if (bound <= top_docs.GetThreshold()) {
+          doc = lead.Advance(bound_end + 1);
+          continue;
+        }
+      }
+
+      std::uint32_t next_doc = doc;
+      for (std::size_t i = 1; i < required.size() && next_doc == doc; ++i) {
+        next_doc = required[i]->postings.Advance(doc);
+      }
+      if (next_doc != doc) {
+        doc = next_doc == kEnd ? kEnd : lead.Advance(next_doc);
+        continue;
+      }
+
+      std::uint32_t doc_length = segment.GetDocLength(doc);
+      float score = 0.0f;
+      for (TermCursor *cursor : required) {
+        score += getScore(*cursor, doc_length);
+      }
+      for (TermCursor *cursor : optional) {
+        if (cursor->postings.Advance(doc) == doc) {
+          score += getScore(*cursor, doc_length);
+        }
+      }
+      // Positions are only decoded for documents that would make it in
+      if ((!top_docs.IsFull() || score > top_docs.GetThreshold()) &&
+          top_docs.IsAfterCursor(doc, score) && matchesPhrases()) {
+        top_docs.Push(doc, score);
+      }
+      doc = lead.Next();
+    }
+  }
+
+  // Block-max WAND: cursors are kept sorted by document, and the pivot is
+  // the first document whose terms could beat the threshold according to
+  // their whole-list bounds. Block bounds then refine that before any
+  // document is decoded.
+  void evaluateDisjunction() {
+    std::vector<TermCursor *> active;
+    for (TermCursor &cursor : cursors) {
+      active.push_back(&cursor);
+    }
+
+    while (true) {
+      std::erase_if(active, [](const TermCursor *cursor) {
+        return cursor->postings.GetDoc() == kEnd;
+      });
+      if (active.empty()) {
+        break;
+      }
+      std::sort(active.begin(), active.end(),
+                [](const TermCursor *a, const TermCursor *b) {
+                  return a->postings.GetDoc() < b->postings.GetDoc();
+                });
+
+      float threshold = top_docs.GetThreshold();
+      float bound = 0.0f;
+      std::size_t pivot = 0;
+      for (; pivot < active.size(); ++pivot) {
+        bound += active[pivot]->max_score;
+        if (bound > threshold) {
+          break;
+        }
+      }
+      if (pivot == active.size()) {
+        break; // Nothing left can beat the threshold
+      }
+      std::uint32_t pivot_doc = active[pivot]->postings.GetDoc();
+      while (pivot + 1 < active.size() &&
+             active[pivot + 1]->postings.GetDoc() == pivot_doc) {
+        ++pivot;
+      }
+
+      float block_bound = 0.0f;
+      std::uint32_t bound_end = kEnd;
+      for (std::size_t i = 0; i <= pivot; ++i) {
+        if (const SkipEntry *block =
+                active[i]->postings.ShallowAdvance(pivot_doc)) {
+          block_bound += getBlockBound(*active[i], *block);
+          bound_end = std::min(bound_end, block->last_doc);
+        }
+      }
+
+      if (block_bound > threshold) {
+        if (active.front()->postings.GetDoc() == pivot_doc) {
+          // Every cursor on the pivot is scored, in query order rather than
+          // in the order they happen to be sorted in, so that the sum, and
+          // so the cursor of a page, does not depend on earlier pruning
+          std::uint32_t doc_length = segment.GetDocLength(pivot_doc);
+          float score = 0.0f;
+          for (TermCursor &cursor : cursors) {
+            if (cursor.postings.GetDoc() == pivot_doc) {
+              score += getScore(cursor, doc_length);
+              cursor.postings.Next();
+            }
+          }
+          top_docs.Push(pivot_doc, score);
+        } else {
+          // Documents before the pivot cannot beat the threshold
+          for (std::size_t i = 0; i < pivot; ++i) {
+            active[i]->postings.Advance(pivot_doc);
+          }
+        }
+      } else {
+        // Neither can anything up to the end of the pivot's blocks, or up to
+        // the next term after the pivot
+        std::uint32_t next_doc = bound_end == kEnd ? kEnd : bound_end + 1;
+        if (pivot + 1 < active.size()) {
+          next_doc = std::min(next_doc, active[pivot + 1]->postings.GetDoc());
+        }
+        for (std::size_t i = 0; i <= pivot; ++i) {
+          active[i]->postings.Advance(next_doc);
+        }
+      }
+    }
+  }
+
+  // Phrase terms are required, so their cursors are all on the document
+  bool matchesPhrases() {
+    for (const auto &phrase : phrases) {
+      if (phrase.size() < 2) {
+        continue;
+      }
+      // Positions where the phrase could have matched up to its i-th word,
+      // which are moved one word on and kept if the next word is there
+      cursors[phrase[0]].postings.GetPositions(positions);
+      for (std::size_t i = 1; i < phrase.size() && !positions.empty(); ++i) {
+        cursors[phrase[i]].postings.GetPositions(other_positions);
+        for (std::uint32_t &position : positions) {
+          ++position;
+        }
+        matched_positions.resize(positions.size());
+        matched_positions.resize(IntersectSorted(
+            positions.data(), positions.size(), other_positions.data(),
+            other_positions.size(), matched_positions.data()));
+        positions.swap(matched_positions);
+      }
+      if (positions.empty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+Searcher::Searcher(const Segment &segment)
+    : segment(segment),
+      average_doc_length(static_cast<float>(segment.GetAverageDocLength())) {}
+
+std::vector<ScoredDoc> Searcher::Search(const Query &query, std::size_t k,
+                                        std::optional<ScoredDoc> after) const {
+  if (k == 0 || query.IsEmpty()) {
+    return {};
+  }
+
+  // One cursor per distinct term, required if any of its uses is
+  std::vector<std::pair<std::string_view, bool>> terms;
+  std::unordered_map<std::string_view, std::size_t> term_indexes;
+  auto addTerm = [&](std::string_view term, bool is_required) {
+    auto [it, is_new] = term_indexes.try_emplace(term, terms.size());
+    if (is_new) {
+      terms.emplace_back(term, is_required);
+    } else {
+      terms[it->second].second = terms[it->second].second || is_required;
+    }
+    return it->second;
+  };
+  for (const std::string &term : query.terms) {
+    addTerm(term, !query.is_disjunction);
+  }
+  std::vector<std::vector<std::size_t>> phrases;
+  for (const auto &phrase : query.phrases) {
+    auto &phrase_terms = phrases.emplace_back();
+    for (const std::string &term : phrase) {
+      phrase_terms.push_back(addTerm(term, true));
+    }
+  }
+
+  // Cursor indexes follow term indexes, so a missing optional term gets an
+  // empty cursor rather than being dropped
+  std::vector<TermCursor> cursors;
+  cursors.reserve(terms.size());
+  for (const auto &[term, is_required] : terms) {
+    const TermEntry *term_entry = segment.FindTerm(term);
+    if (!term_entry) {
+      if (is_required) {
+        return {};
+      }
+      static const TermEntry kEmptyTerm{};
+      cursors.push_back({PostingIterator(segment, kEmptyTerm), 0.0f, 0.0f,
+                         false});
+      continue;
+    }
+    float idf = GetIdf(term_entry->doc_freq);
+    cursors.push_back(
+        {PostingIterator(segment, *term_entry), idf,
+         Score(idf, term_entry->max_freq, term_entry->min_doc_length),
+         is_required});
+  }
+
+  QueryEvaluator evaluator(*this, segment, cursors, phrases, k, after);
+  return evaluator.Evaluate();
+}
+
+float Searcher::Score(float idf, std::uint32_t freq,
+                      std::uint32_t doc_length) const {
+  float tf = static_cast<float>(freq);
+  float length_norm =
+      average_doc_length > 0.0f
+          ? 1.0f - kB + kB * static_cast<float>(doc_length) / average_doc_length
+          : 1.0f;
+  return idf * tf * (kK1 + 1.0f) / (tf + kK1 * length_norm);
+}
+
+float Searcher::GetIdf(std::uint32_t doc_freq) const {
+  float doc_count = static_cast<float>(segment.GetDocCount());
+  return std::log(1.0f + (doc_count - static_cast<float>(doc_freq) + 0.5f) /
+                             (static_cast<float>(doc_freq) + 0.5f));
+}
+
+} // namespace indexer
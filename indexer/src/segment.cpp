@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "segment.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace indexer {
+
+Segment::Segment(const std::string &path) : file(path) {
+  data = file.GetData();
+  size = file.GetSize();
+  header = reinterpret_cast<const SegmentHeader *>(data);
+  validate(path);
+
+  term_entries = reinterpret_cast<const TermEntry *>(data + header->terms_offset);
+  doc_lengths =
+      reinterpret_cast<const std::uint32_t *>(data + header->doc_lengths_offset);
+  doc_entries = reinterpret_cast<const DocEntry *>(data + header->docs_offset);
+}
+
+std::uint32_t Segment::GetDocCount() const { return header->doc_count; }
+
+std::uint64_t Segment::GetTermCount() const { return header->term_count; }
+
+double Segment::GetAverageDocLength() const {
+  return header->doc_count == 0 ? 0.0
+                                : static_cast<double>(header->total_doc_length) /
+                                      header->doc_count;
+}
+
+std::uint64_t Segment::GetSourceGeneration() const {
+  return header->source_generation;
+}
+
+std::uint32_t Segment::GetDocLength(std::uint32_t doc_id) const {
+  return doc_lengths[doc_id];
+}
+
+std::string_view Segment::GetUrl(std::uint32_t doc_id) const {
+  const DocEntry &doc_entry = doc_entries[doc_id];
+  return {reinterpret_cast<const char *>(data + doc_entry.url_offset),
+          doc_entry.url_length};
+}
+
+std::string_view Segment::GetTitle(std::uint32_t doc_id) const {
+  const DocEntry &doc_entry = doc_entries[doc_id];
+  return {reinterpret_cast<const char *>(data + doc_entry.title_offset),
+          doc_entry.title_length};
+}
+
+std::string_view Segment::GetText(std::uint32_t doc_id) const {
+  const DocEntry &doc_entry = doc_entries[doc_id];
+  return {reinterpret_cast<const char *>(data + doc_entry.text_offset),
+          doc_entry.text_length};
+}
+
+const TermEntry *Segment::FindTerm(std::string_view term) const {
+  std::uint64_t low = 0;
+  std::uint64_t high = header->term_count;
+  while (low < high) {
+    std::uint64_t middle = low + (high - low) / 2;
+    int order = GetTerm(term_entries[middle]).compare(term);
+    if (order == 0) {
+      return &term_entries[middle];
+    }
+    if (order < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return nullptr;
+}
+
+const TermEntry &Segment::GetTermEntry(std::uint64_t index) const {
+  return term_entries[index];
+}
+
+std::string_view Segment::GetTerm(const TermEntry &term_entry) const {
+  return {reinterpret_cast<const char *>(data + term_entry.string_offset),
+          term_entry.string_length};
+}
+
+const std::uint8_t *Segment::GetData(std::uint64_t offset) const {
+  return data + offset;
+}
+
+// Private methods
+
+void Segment::validate(const std::string &path) const {
+  if (size < sizeof(SegmentHeader)) {
+    throw std::runtime_error("Invalid segment: " + path);
+  }
+  if (std::memcmp(header->magic, kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+    throw std::runtime_error("Not a segment: " + path);
+  }
+  if (header->version != kSegmentVersion) {
+    throw std::runtime_error("Unsupported segment version " +
+                             std::to_string(header->version) + ": " + path);
+  }
+
+  // Only the section table is checked; the sections themselves are trusted,
+  // as segments are only written by SegmentWriter
+  auto fits = [&](std::uint64_t offset, std::uint64_t count,
+                  std::uint64_t element_size) {
+    return offset <= size && count <= (size - offset) / element_size;
+  };
+  if (header->file_size != size ||
+      !fits(header->terms_offset, header->term_count, sizeof(TermEntry)) ||
+      !fits(header->doc_lengths_offset, header->doc_count,
+            sizeof(std::uint32_t)) ||
+      !fits(header->docs_offset, header->doc_count, sizeof(DocEntry))) {
+    throw std::runtime_error("Truncated or corrupted segment: " + path);
+  }
+}
+
+} // namespace indexer
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "segment_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "bit_packing.hpp"
+#include "mapped_file.hpp"
+#include "tokenizer.hpp"
+
+namespace indexer {
+
+namespace {
+
+// Texts are stored for snippets, which are usually cut from near the
+// start, so a long page only keeps its beginning
+constexpr std::size_t kMaxStoredTextLength = 16 * 1024;
+
+template <typename T> void appendRaw(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void alignTo(std::string &out, std::size_t alignment) {
+  out.resize((out.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+std::uint32_t checkedOffset(std::size_t offset) {
+  if (offset > UINT32_MAX) {
+    throw std::runtime_error("Posting list of a term is larger than 4 GiB");
+  }
+  return static_cast<std::uint32_t>(offset);
+}
+
+} // namespace
+
+std::uint32_t SegmentWriter::AddDocument(std::string_view url,
+                                         std::string_view title,
+                                         std::string_view text) {
+  auto doc_id = static_cast<std::uint32_t>(docs.size());
+
+  std::uint32_t position = 0;
+  ForEachToken(title, [&](std::string_view token) {
+    addToken(token, doc_id, position++);
+  });
+  std::uint32_t doc_length = position;
+  position += kFieldPositionGap;
+  ForEachToken(text, [&](std::string_view token) {
+    addToken(token, doc_id, position++);
+    ++doc_length;
+  });
+
+  doc_lengths.push_back(doc_length);
+  total_doc_length += doc_length;
+
+  std::string stored_text = CompactText(text, kMaxStoredTextLength);
+  DocEntry doc_entry{
+      .url_offset = doc_strings.size(),
+      .title_offset = doc_strings.size() + url.size(),
+      .text_offset = doc_strings.size() + url.size() + title.size(),
+      .url_length = static_cast<std::uint32_t>(url.size()),
+      .title_length = static_cast<std::uint32_t>(title.size()),
+      .text_length = static_cast<std::uint32_t>(stored_text.size()),
+      .reserved = 0};
+  doc_strings.append(url);
+  doc_strings.append(title);
+  doc_strings.append(stored_text);
+  docs.push_back(doc_entry);
+  return doc_id;
+}
+
+std::uint32_t SegmentWriter::GetDocCount() const {
+  return static_cast<std::uint32_t>(docs.size());
+}
+
+std::size_t SegmentWriter::GetTermCount() const { return terms.size(); }
+
+bool SegmentWriter::Write(const std::string &path,
+                          std::uint64_t source_generation) const {
+  std::vector<const decltype(terms)::value_type *> sorted_terms;
+  sorted_terms.reserve(terms.size());
+  for (const auto &term : terms) {
+    sorted_terms.push_back(&term);
+  }
+  std::sort(sorted_terms.begin(), sorted_terms.end(),
+            [](const auto *a, const auto *b) { return a->first < b->first; });
+
+  // Encode the variable-sized sections first, with offsets relative to them
+  std::vector<TermEntry> term_entries;
+  term_entries.reserve(sorted_terms.size());
+  std::string term_strings;
+  std::string postings;
+  std::string positions;
+  for (const auto *term : sorted_terms) {
+    alignTo(postings, 4);
+    TermEntry &term_entry = term_entries.emplace_back(
+        TermEntry{.string_offset = term_strings.size(),
+                  .string_length = static_cast<std::uint32_t>(term->first.size()),
+                  .doc_freq =
+                      static_cast<std::uint32_t>(term->second.docs.size()),
+                  .postings_offset = postings.size(),
+                  .positions_offset = positions.size(),
+                  .max_freq = 0,
+                  .min_doc_length = UINT32_MAX});
+    term_strings.append(term->first);
+    encodePostings(term->second, term_entry, postings, positions);
+  }
+
+  // Then lay the sections out and make the offsets absolute
+  SegmentHeader header{};
+  std::memcpy(header.magic, kSegmentMagic, sizeof(kSegmentMagic));
+  header.version = kSegmentVersion;
+  header.doc_count = GetDocCount();
+  header.term_count = term_entries.size();
+  header.total_doc_length = total_doc_length;
+  header.source_generation = source_generation;
+
+  std::uint64_t offset = sizeof(SegmentHeader);
+  header.terms_offset = offset;
+  offset += term_entries.size() * sizeof(TermEntry);
+  std::uint64_t term_strings_offset = offset;
+  offset = (offset + term_strings.size() + 3) / 4 * 4;
+  std::uint64_t postings_offset = offset;
+  offset += postings.size();
+  std::uint64_t positions_offset = offset;
+  offset = (offset + positions.size() + 3) / 4 * 4;
+  header.doc_lengths_offset = offset;
+  offset = (offset + doc_lengths.size() * sizeof(std::uint32_t) + 7) / 8 * 8;
+  header.docs_offset = offset;
+  offset += docs.size() * sizeof(DocEntry);
+  std::uint64_t doc_strings_offset = offset;
+  header.file_size = offset + doc_strings.size();
+
+  std::string data;
+  data.reserve(header.file_size);
+  appendRaw(data, header);
+  for (TermEntry term_entry : term_entries) {
+    term_entry.string_offset += term_strings_offset;
+    term_entry.postings_offset += postings_offset;
+    term_entry.positions_offset += positions_offset;
+    appendRaw(data, term_entry);
+  }
+  data.append(term_strings);
+  alignTo(data, 4);
+  data.append(postings);
+  data.append(positions);
+  alignTo(data, 4);
+  data.append(reinterpret_cast<const char *>(doc_lengths.data()),
+              doc_lengths.size() * sizeof(std::uint32_t));
+  alignTo(data, 8);
+  for (DocEntry doc_entry : docs) {
+    doc_entry.url_offset += doc_strings_offset;
+    doc_entry.title_offset += doc_strings_offset;
+    doc_entry.text_offset += doc_strings_offset;
+    appendRaw(data, doc_entry);
+  }
+  data.append(doc_strings);
+
+  if (!WriteFileAtomically(path, data)) {
+    std::cerr << "Failed to write segment file: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Private methods
+
+void SegmentWriter::addToken(std::string_view token, std::uint32_t doc_id,
+                             std::uint32_t position) {
+  auto it = terms.find(token);
+  if (it == terms.end()) {
+    it = terms.emplace(std::string(token), TermPostings()).first;
+  }
+
+  TermPostings &term_postings = it->second;
+  if (term_postings.docs.empty() || term_postings.docs.back() != doc_id) {
+    term_postings.docs.push_back(doc_id);
+    term_postings.freqs.push_back(0);
+  }
+  ++term_postings.freqs.back();
+  term_postings.positions.push_back(position);
+}
+
+void SegmentWriter::encodePostings(const TermPostings &term_postings,
+                                   TermEntry &term_entry,
+                                   std::string &postings,
+                                   std::string &positions) const {
+  const std::size_t doc_freq = term_postings.docs.size();
+  const std::size_t block_count = (doc_freq + kBlockSize - 1) / kBlockSize;
+
+  // Skip entries are filled in as blocks are written
+  const std::size_t skip_table_offset = postings.size();
+  postings.resize(postings.size() + block_count * sizeof(SkipEntry));
+  const std::size_t blocks_offset = postings.size();
+  const std::size_t term_positions_offset = positions.size();
+
+  std::uint32_t gaps[kBlockSize];
+  std::uint32_t freqs[kBlockSize];
+  std::uint32_t packed[kBlockSize];
+  std::int64_t previous_doc = -1;
+  std::size_t next_position = 0;
+
+  for (std::size_t block = 0; block < block_count; ++block) {
+    const std::size_t begin = block * kBlockSize;
+    const std::size_t count = std::min<std::size_t>(kBlockSize, doc_freq - begin);
+
+    SkipEntry skip_entry{
+        .last_doc = term_postings.docs[begin + count - 1],
+        .block_offset = checkedOffset(postings.size() - blocks_offset),
+        .positions_offset =
+            checkedOffset(positions.size() - term_positions_offset),
+        .max_freq = 0,
+        .min_doc_length = UINT32_MAX};
+
+    for (std::size_t i = 0; i < count; ++i) {
+      std::uint32_t doc = term_postings.docs[begin + i];
+      skip_entry.max_freq =
+          std::max(skip_entry.max_freq, term_postings.freqs[begin + i]);
+      skip_entry.min_doc_length =
+          std::min(skip_entry.min_doc_length, doc_lengths[doc]);
+      gaps[i] = static_cast<std::uint32_t>(doc - previous_doc - 1);
+      freqs[i] = term_postings.freqs[begin + i] - 1;
+      previous_doc = doc;
+
+      // Positions of a document are increasing, so they are delta-encoded
+      std::uint32_t previous_position = 0;
+      for (std::uint32_t j = 0; j < term_postings.freqs[begin + i]; ++j) {
+        std::uint32_t position = term_postings.positions[next_position++];
+        AppendVarint(positions, position - previous_position);
+        previous_position = position;
+      }
+    }
+
+    std::memcpy(postings.data() + skip_table_offset + block * sizeof(SkipEntry),
+                &skip_entry, sizeof(SkipEntry));
+    term_entry.max_freq = std::max(term_entry.max_freq, skip_entry.max_freq);
+    term_entry.min_doc_length =
+        std::min(term_entry.min_doc_length, skip_entry.min_doc_length);
+
+    if (count == kBlockSize) {
+      std::uint32_t gap_bits = RequiredBits(gaps);
+      std::uint32_t freq_bits = RequiredBits(freqs);
+      appendRaw(postings, gap_bits | (freq_bits << 8));
+      PackBlock(gaps, gap_bits, packed);
+      postings.append(reinterpret_cast<const char *>(packed),
+                      PackedBlockWords(gap_bits) * sizeof(std::uint32_t));
+      PackBlock(freqs, freq_bits, packed);
+      postings.append(reinterpret_cast<const char *>(packed),
+                      PackedBlockWords(freq_bits) * sizeof(std::uint32_t));
+    } else {
+      for (std::size_t i = 0; i < count; ++i) {
+        AppendVarint(postings, gaps[i]);
+      }
+      for (std::size_t i = 0; i < count; ++i) {
+        AppendVarint(postings, freqs[i]);
+      }
+      alignTo(postings, 4);
+    }
+  }
+}
+
+} // namespace indexer
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "simd.hpp"
+
+#include <algorithm>
+
+namespace indexer {
+
+namespace {
+
+SimdLevel detectSimdLevel() {
+#if SEARCHLIGHT_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::kAvx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return SimdLevel::kSse41;
+  }
+#endif
+  return SimdLevel::kScalar;
+}
+
+const SimdLevel supported_level = detectSimdLevel();
+SimdLevel current_level = supported_level;
+
+} // namespace
+
+SimdLevel GetSupportedSimdLevel() { return supported_level; }
+
+SimdLevel GetSimdLevel() { return current_level; }
+
+void SetSimdLevel(SimdLevel level) {
+  current_level = std::min(level, supported_level);
+}
+
+const char *GetSimdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::kAvx2:
+    return "AVX2";
+  case SimdLevel::kSse41:
+    return "SSE4.1";
+  case SimdLevel::kScalar:
+    break;
+  }
+  return "scalar";
+}
+
+} // namespace indexer
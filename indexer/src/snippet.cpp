@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "snippet.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string_view>
+
+#include "posting_iterator.hpp"
+#include "tokenizer.hpp"
+
+namespace indexer {
+
+namespace {
+
+// Length of a snippet in tokens, of which the first few are context shown
+// before the first query term
+constexpr std::uint32_t kSnippetTokenCount = 32;
+constexpr std::uint32_t kContextTokenCount = 6;
+
+// Snippets of long tokens are cut short anyway
+constexpr std::size_t kMaxSnippetLength = 320;
+
+// Tokens scanned between two looks at the clock
+constexpr std::uint32_t kDeadlineCheckInterval = 64;
+
+constexpr std::string_view kEllipsis = "…";
+
+// An occurrence of a query term in the text of a document
+struct Hit {
+  std::uint32_t position;
+  std::uint32_t term_index;
+};
+
+// Returns the position the snippet should start at: the one showing the
+// most distinct terms, then the most occurrences, earliest first.
+std::uint32_t chooseStart(const std::vector<Hit> &hits,
+                          std::size_t term_count) {
+  if (hits.empty()) {
+    return 0;
+  }
+
+  constexpr std::uint32_t kWindowLength =
+      kSnippetTokenCount - kContextTokenCount;
+  std::vector<std::uint32_t> counts(term_count, 0);
+  std::size_t distinct_count = 0;
+  std::size_t best_distinct_count = 0;
+  std::size_t best_hit_count = 0;
+  std::uint32_t best_position = hits.front().position;
+
+  // Windows start at a hit, and take in every hit less than kWindowLength
+  // positions after it
+  std::size_t end = 0;
+  for (std::size_t begin = 0; begin < hits.size(); ++begin) {
+    while (end < hits.size() &&
+           hits[end].position < hits[begin].position + kWindowLength) {
+      distinct_count += counts[hits[end].term_index]++ == 0;
+      ++end;
+    }
+    if (distinct_count > best_distinct_count ||
+        (distinct_count == best_distinct_count &&
+         end - begin > best_hit_count)) {
+      best_distinct_count = distinct_count;
+      best_hit_count = end - begin;
+      best_position = hits[begin].position;
+    }
+    distinct_count -= --counts[hits[begin].term_index] == 0;
+  }
+
+  return best_position > kContextTokenCount
+             ? best_position - kContextTokenCount
+             : 0;
+}
+
+// Scans `text` to the tokens from position `start` on and cuts them out,
+// highlighting the hits among them. Returns nullopt if the text ends
+// before `start`, or if `deadline` passes first.
+std::optional<Snippet>
+cutSnippet(std::string_view text, std::uint32_t start,
+           const std::vector<Hit> &hits,
+           std::chrono::steady_clock::time_point deadline) {
+  auto hit = std::lower_bound(
+      hits.begin(), hits.end(), start,
+      [](const Hit &hit, std::uint32_t position) {
+        return hit.position < position;
+      });
+
+  std::size_t offset = 0;
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  std::vector<Highlight> highlights;
+  std::uint32_t position = 0;
+  std::optional<TokenSpan> span;
+  for (; position < start + kSnippetTokenCount; ++position) {
+    if (position % kDeadlineCheckInterval == 0 && position > 0 &&
+        std::chrono::steady_clock::now() > deadline) {
+      return std::nullopt;
+    }
+    if (!(span = FindNextToken(text, offset))) {
+      break;
+    }
+    offset = span->end;
+    if (position < start) {
+      continue;
+    }
+
+    if (position == start) {
+      begin = span->begin;
+    } else if (span->end - begin > kMaxSnippetLength) {
+      break;
+    }
+    end = span->end;
+
+    while (hit != hits.end() && hit->position < position) {
+      ++hit;
+    }
+    if (hit != hits.end() && hit->position == position) {
+      highlights.push_back({static_cast<std::uint32_t>(span->begin - begin),
+                            static_cast<std::uint32_t>(span->end - begin)});
+    }
+  }
+  if (position <= start && start > 0) {
+    return std::nullopt;
+  }
+
+  Snippet snippet;
+  if (start > 0) {
+    snippet.text.append(kEllipsis).append(" ");
+    for (Highlight &highlight : highlights) {
+      highlight.begin += static_cast<std::uint32_t>(snippet.text.size());
+      highlight.end += static_cast<std::uint32_t>(snippet.text.size());
+    }
+  }
+  snippet.text.append(text.substr(begin, end - begin));
+  if (FindNextToken(text, end)) {
+    snippet.text.append(" ").append(kEllipsis);
+  }
+  snippet.highlights = std::move(highlights);
+  return snippet;
+}
+
+} // namespace
+
+std::vector<Snippet> MakeSnippets(const Segment &segment, const Query &query,
+                                  std::span<const std::uint32_t> doc_ids,
+                                  std::chrono::microseconds time_budget) {
+  // Every word of the query is highlighted, phrase or not
+  std::set<std::string_view> terms(query.terms.begin(), query.terms.end());
+  for (const auto &phrase : query.phrases) {
+    terms.insert(phrase.begin(), phrase.end());
+  }
+  std::vector<PostingIterator> postings;
+  for (std::string_view term : terms) {
+    if (const TermEntry *term_entry = segment.FindTerm(term)) {
+      postings.emplace_back(segment, *term_entry);
+    }
+  }
+
+  // Posting lists only move forward, so documents are visited in id order
+  std::vector<std::size_t> order(doc_ids.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    return doc_ids[a] < doc_ids[b];
+  });
+
+  std::vector<Snippet> snippets(doc_ids.size());
+  std::vector<Hit> hits;
+  std::vector<std::uint32_t> positions;
+  for (std::size_t index : order) {
+    std::uint32_t doc_id = doc_ids[index];
+    auto deadline = std::chrono::steady_clock::now() + time_budget;
+
+    // Positions of the text come after those of the title
+    std::uint32_t text_start = kFieldPositionGap;
+    ForEachToken(segment.GetTitle(doc_id),
+                 [&](std::string_view) { ++text_start; });
+
+    hits.clear();
+    for (std::size_t i = 0; i < postings.size(); ++i) {
+      if (postings[i].Advance(doc_id) != doc_id) {
+        continue;
+      }
+      postings[i].GetPositions(positions);
+      for (std::uint32_t position : positions) {
+        if (position >= text_start) {
+          hits.push_back(
+              {position - text_start, static_cast<std::uint32_t>(i)});
+        }
+      }
+    }
+    std::sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+      return a.position < b.position;
+    });
+
+    // The best passage can be past the stored part of a long text, or too
+    // far into it to reach in time; the start of the text is the fallback
+    std::string_view text = segment.GetText(doc_id);
+    std::optional<Snippet> snippet =
+        cutSnippet(text, chooseStart(hits, postings.size()), hits, deadline);
+    if (!snippet.has_value()) {
+      snippet = cutSnippet(text, 0, hits,
+                           std::chrono::steady_clock::time_point::max());
+    }
+    snippets[index] = std::move(*snippet);
+  }
+  return snippets;
+}
+
+} // namespace indexer
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: AGPL-3.0-only
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace indexer {
+
+namespace {
+
+// Elements whose content is not text of the page
+constexpr std::array<std::string_view, 4> kSkippedElements = {
+    "script", "style", "noscript", "template"};
+
+// Elements that usually sit inside a word or sentence, and so do not
+// separate words like other tags do
+constexpr std::array<std::string_view, 12> kInlineElements = {
+    "a", "abbr", "b", "code", "em", "i", "mark", "s", "small", "span",
+    "strong", "u"};
+
+constexpr std::size_t kMaxEntityLength = 10;
+
+char toLower(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+
+bool startsWithIgnoreCase(std::string_view text, std::string_view prefix) {
+  if (text.size() < prefix.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < prefix.size(); ++i) {
+    if (toLower(text[i]) != prefix[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void appendUtf8(std::string &out, std::uint32_t code_point) {
+  if (code_point == 0 || code_point > 0x10FFFF ||
+      (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+    out += ' ';
+  } else if (code_point < 0x80) {
+    out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    out += static_cast<char>(0xC0 | (code_point >> 6));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    out += static_cast<char>(0xE0 | (code_point >> 12));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code_point >> 18));
+    out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+// Decodes the character reference at the start of `html` (which begins with
+// '&'). Returns its length, or 0 if it is not one we know.
+std::size_t decodeEntity(std::string_view html, std::string &out) {
+  std::size_t end = html.find(';', 1);
+  if (end == std::string_view::npos || end > kMaxEntityLength) {
+    return 0;
+  }
+  std::string_view name = html.substr(1, end - 1);
+
+  if (name.size() > 1 && name[0] == '#') {
+    bool is_hex = name[1] == 'x' || name[1] == 'X';
+    std::uint32_t code_point = 0;
+    for (std::size_t i = is_hex ? 2 : 1; i < name.size(); ++i) {
+      char c = toLower(name[i]);
+      std::uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (is_hex && c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else {
+        return 0;
+      }
+      code_point = code_point * (is_hex ? 16 : 10) + digit;
+    }
+    appendUtf8(out, code_point);
+    return end + 1;
+  }
+
+  if (name == "amp") {
+    out += '&';
+  } else if (name == "lt") {
+    out += '<';
+  } else if (name == "gt") {
+    out += '>';
+  } else if (name == "quot") {
+    out += '"';
+  } else if (name == "apos") {
+    out += '\'';
+  } else if (name == "nbsp") {
+    out += ' ';
+  } else {
+    return 0;
+  }
+  return end + 1;
+}
+
+// Returns true if `tag` (the text after '<') opens or closes `element`
+bool isTag(std::string_view tag, std::string_view element) {
+  if (tag.starts_with('/')) {
+    tag.remove_prefix(1);
+  }
+  return startsWithIgnoreCase(tag, element) &&
+         (tag.size() == element.size() || !IsTokenChar(tag[element.size()]));
+}
+
+// Returns the position right after the tag starting at `begin`, skipping
+// over quoted attribute values.
+std::size_t skipTag(std::string_view html, std::size_t begin) {
+  char quote = 0;
+  for (std::size_t i = begin; i < html.size(); ++i) {
+    char c = html[i];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+    } else if (c == '>') {
+      return i + 1;
+    }
+  }
+  return html.size();
+}
+
+} // namespace
+
+std::string ExtractText(std::string_view html) {
+  std::string text;
+  text.reserve(html.size() / 2);
+
+  std::size_t i = 0;
+  while (i < html.size()) {
+    char c = html[i];
+    if (c == '&') {
+      if (std::size_t length = decodeEntity(html.substr(i), text)) {
+        i += length;
+      } else {
+        text += c;
+        ++i;
+      }
+      continue;
+    }
+    if (c != '<') {
+      text += c;
+      ++i;
+      continue;
+    }
+
+    std::string_view rest = html.substr(i);
+    if (rest.starts_with("<!--")) {
+      std::size_t end = html.find("-->", i + 4);
+      i = end == std::string_view::npos ? html.size() : end + 3;
+      text += ' ';
+      continue;
+    }
+
+    i = skipTag(html, i + 1);
+    std::string_view tag = rest.substr(1);
+    if (std::none_of(kInlineElements.begin(), kInlineElements.end(),
+                     [&](std::string_view element) {
+                       return isTag(tag, element);
+                     })) {
+      text += ' ';
+    }
+
+    for (std::string_view element : kSkippedElements) {
+      if (!tag.starts_with('/') && isTag(tag, element)) {
+        // Skip to the matching end tag
+        std::size_t end = i;
+        while ((end = html.find("</", end)) != std::string_view::npos &&
+               !startsWithIgnoreCase(html.substr(end + 2), element)) {
+          end += 2;
+        }
+        i = end == std::string_view::npos ? html.size() : skipTag(html, end);
+        break;
+      }
+    }
+  }
+  return text;
+}
+
+std::string CompactText(std::string_view text, std::size_t max_length) {
+  std::string compact;
+  compact.reserve(std::min(text.size(), max_length));
+  bool is_after_space = true; // Trims leading whitespace
+  for (char c : text) {
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+        c == '\v') {
+      if (!is_after_space) {
+        compact += ' ';
+        is_after_space = true;
+      }
+      continue;
+    }
+    if (compact.size() >= max_length) {
+      // Never leave half a word (or half a UTF-8 sequence) at the end
+      std::size_t last_space = compact.rfind(' ');
+      compact.resize(last_space == std::string::npos ? 0 : last_space);
+      return compact;
+    }
+    compact += c;
+    is_after_space = false;
+  }
+  if (!compact.empty() && compact.back() == ' ') {
+    compact.pop_back();
+  }
+  return compact;
+}
+
+} // namespace indexer
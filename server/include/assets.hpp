@@ -0,0 +1,69 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+#include "cpp-httplib/httplib.h"
+#include "inja/inja.hpp"
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+// A file served as is, held in memory together with its precompressed
+// variants. With `watch_for_changes` the file is reloaded when it changes on
+// disk, which is meant for development.
+class StaticPage {
+public:
+    StaticPage(std::string file_path, std::string content_type, bool watch_for_changes);
+
+    // Answers with the variant the client accepts, or with 304 Not Modified
+    // if the client already has the current version.
+    void Serve(const httplib::Request &req, httplib::Response &res);
+
+private:
+    struct Encoding {
+        std::string body;
+        std::string etag;
+    };
+
+    // A compressed variant is left empty when it would not be smaller
+    struct Variants {
+        Encoding identity;
+        Encoding gzip;
+        Encoding brotli;
+    };
+
+    std::string file_path;
+    std::string content_type;
+    bool watch_for_changes;
+
+    std::shared_mutex mutex;
+    std::shared_ptr<const Variants> variants;
+    std::filesystem::file_time_type last_write_time;
+
+    std::shared_ptr<const Variants> currentVariants();
+    std::shared_ptr<const Variants> load();
+};
+
+// An inja template parsed once. With `watch_for_changes` it is parsed again
+// when the file changes on disk, which is meant for development.
+class TemplateFile {
+public:
+    TemplateFile(inja::Environment &env, std::string file_path, bool watch_for_changes);
+
+    std::string Render(const nlohmann::json &data);
+
+private:
+    inja::Environment &env;
+    std::string file_path;
+    bool watch_for_changes;
+
+    std::shared_mutex mutex;
+    inja::Template parsed_template;
+    std::filesystem::file_time_type last_write_time;
+
+    void reloadIfChanged();
+};
+
+} // namespace server
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "search_index.hpp"
+
+namespace server {
+
+// An in-memory LRU cache of search results, split into shards that are
+// locked independently so concurrent requests rarely contend.
+//
+// Every entry is tagged with the index generation it was computed at. Once
+// the generation moves on, because the crawler committed new pages, older
+// entries are treated as misses and dropped.
+class ResultCache {
+public:
+    using Results = std::shared_ptr<const std::vector<SearchResult>>;
+
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::size_t entry_count;
+        std::size_t memory_usage;
+        // Unknown while the cache is disabled
+        std::optional<std::uint64_t> generation;
+    };
+
+    explicit ResultCache(std::size_t memory_limit_bytes);
+
+    // Returns the cached results for the key, or null.
+    Results Lookup(const std::string &key);
+
+    // Caches results computed at `generation`, as returned by GetGeneration()
+    // before searching. They are dropped if the generation has changed since.
+    void Insert(const std::string &key, Results results, std::uint64_t generation);
+
+    std::uint64_t GetGeneration() const;
+
+    // Moves to a new generation, which invalidates every entry. An unknown
+    // generation disables the cache until a known one is set.
+    void SetGeneration(std::optional<std::uint64_t> generation);
+
+    Stats GetStats() const;
+
+    // Turns a query, and the encoded cursor and size of a page of its
+    // results, into the key they are cached under, so that queries that only
+    // differ in case or spacing share an entry. The backend is part of the
+    // key: the segment and FTS5 rank differently, and the generations they
+    // are tagged with can be the same.
+    static std::string NormalizeKey(SearchBackend backend, std::string_view query,
+                                    std::string_view cursor, int limit);
+
+private:
+    static constexpr std::size_t kShardCount = 16;
+    static constexpr std::uint64_t kDisabledGeneration = UINT64_MAX;
+
+    struct Entry {
+        std::string key;
+        Results results;
+        std::uint64_t generation;
+        std::size_t size;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        std::size_t memory_usage = 0;
+    };
+
+    std::array<Shard, kShardCount> shards;
+    std::size_t shard_memory_limit;
+    std::atomic<std::uint64_t> generation{kDisabledGeneration};
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+
+    Shard &getShard(std::string_view key);
+    static void erase(Shard &shard, std::list<Entry>::iterator it);
+};
+
+} // namespace server
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "snippet.hpp"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace server {
+
+// The index a search was answered from.
+enum class SearchBackend { kFts, kSegment };
+
+// Where a result stands in the ranking of its backend: the BM25 score the
+// segment gives it and its document id, or the FTS5 rank and rowid of the
+// page. The next page of results resumes after the last result of the
+// previous one, so going deep costs no more than the first page. A cursor
+// only makes sense to the backend it came from, which ignores the others.
+struct SearchCursor {
+    SearchBackend backend;
+    double score;
+    std::int64_t doc_id;
+};
+
+struct SearchResult {
+    std::string url;
+    std::string title;
+    // Text of the page around the query terms, which are highlighted
+    indexer::Snippet snippet;
+    SearchCursor cursor;
+};
+
+// Runs full-text searches against the crawler's `webpages` FTS5 table.
+//
+// Every search borrows a read-only connection from a pool that is opened up
+// front, one per server worker thread, each with its search statement
+// already prepared. As the crawler keeps the database in WAL mode, these
+// readers never block on its writes and see the last committed batch.
+class SearchIndex {
+public:
+    SearchIndex(const std::string &db_path, const std::string &fts_html_ext_path,
+                int mmap_size_mb, std::size_t connection_count);
+    ~SearchIndex();
+
+    SearchIndex(const SearchIndex &) = delete;
+    SearchIndex &operator=(const SearchIndex &) = delete;
+
+    // Returns the best `limit` pages for the query that rank after `after`,
+    // best first, or nullopt if the database could not be queried. A cursor
+    // of the segment starts from the best page.
+    std::optional<std::vector<SearchResult>> Search(std::string_view query, int limit,
+                                                    std::optional<SearchCursor> after);
+
+    // Returns the index generation, which the crawler increments with every
+    // batch of pages it commits, or nullopt if the database has none yet.
+    std::optional<std::uint64_t> GetGeneration();
+
+private:
+    struct Connection;
+
+    std::string db_path;
+    std::string fts_html_ext_path;
+    int mmap_size_mb;
+
+    std::mutex pool_mutex;
+    std::vector<std::unique_ptr<Connection>> idle_connections;
+
+    std::unique_ptr<Connection> openConnection() const;
+    std::unique_ptr<Connection> acquireConnection();
+    void releaseConnection(std::unique_ptr<Connection> connection);
+};
+
+// Turns free text into an FTS5 query that matches pages containing every
+// word. Each word is quoted, so FTS5 operators and syntax in user input are
+// searched for literally instead of being interpreted.
+std::string BuildMatchExpression(std::string_view query);
+
+// Encodes a cursor for use in a URL, prefixed with its backend (`f` or
+// `s`). The score is encoded bit for bit, so that the cursor compares equal
+// to the result it came from.
+std::string EncodeCursor(const SearchCursor &cursor);
+
+// Parses an encoded cursor, or returns nullopt if it is not one.
+std::optional<SearchCursor> ParseCursor(std::string_view text);
+
+} // namespace server
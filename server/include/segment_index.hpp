@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_index.hpp"
+#include "segment.hpp"
+#include "watched_file.hpp"
+
+namespace server {
+
+// Runs searches against the segment written by the indexer, with the
+// native top-k BM25 evaluator, and switches to a new segment when the
+// indexer replaces the file. Searches in flight keep the segment they
+// started with.
+class SegmentIndex {
+public:
+    explicit SegmentIndex(std::string segment_path);
+
+    // Opens the segment file again if it has changed since it was last
+    // opened. Returns false if no segment is available.
+    bool Refresh();
+
+    // Returns the current segment, or null if there is none.
+    std::shared_ptr<const indexer::Segment> GetSegment() const;
+
+    // Returns the best `limit` pages for the query that rank after `after`,
+    // best first, or nullopt if there is no segment to search. A cursor of
+    // FTS5 starts from the best page.
+    std::optional<std::vector<SearchResult>> Search(std::string_view query, int limit,
+                                                    std::optional<SearchCursor> after) const;
+
+private:
+    WatchedFile<indexer::Segment> segment;
+};
+
+} // namespace server
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "completion_trie.hpp"
+#include "watched_file.hpp"
+
+namespace server {
+
+// Suggests queries from the completion trie the indexer builds from the
+// vocabulary of the segment, and switches to a new trie when the indexer
+// replaces the file.
+class SuggestIndex {
+public:
+    explicit SuggestIndex(std::string trie_path);
+
+    // Opens the trie file again if it has changed since it was last opened.
+    // Returns false if no trie is available.
+    bool Refresh();
+
+    // Completes the last word of the query with the `limit` most common
+    // words starting with it, and returns the resulting queries, best first.
+    // Returns nothing if there is no trie or the query does not end in a
+    // word.
+    std::vector<std::string> Suggest(std::string_view query, std::size_t limit) const;
+
+private:
+    WatchedFile<indexer::CompletionTrie> trie;
+};
+
+} // namespace server
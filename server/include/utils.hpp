@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "snippet.hpp"
+
+namespace utils {
+
+// Escapes text for use in HTML content and quoted attribute values. inja
+// does not escape what it renders, so every value from a request or from the
+// index has to go through this first.
+std::string EscapeHtml(std::string_view text);
+
+// Percent-encodes text for use as the value of a URL query parameter.
+std::string EncodeQueryParam(std::string_view text);
+
+// Escapes the text of a snippet and wraps its highlights in <mark> tags.
+std::string RenderSnippet(const indexer::Snippet &snippet);
+
+// Compresses data in the gzip format at the highest level. Returns an empty
+// string on failure.
+std::string GzipCompress(std::string_view data);
+
+// Compresses data with Brotli at the highest quality. Returns an empty string
+// on failure, or if the server was built without Brotli.
+std::string BrotliCompress(std::string_view data);
+
+// Returns true if the Accept-Encoding header value allows the encoding, that
+// is if it lists it (or "*") without a zero quality.
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view encoding);
+
+// Returns true if the If-None-Match header value matches the entity tag.
+bool MatchesEtag(std::string_view if_none_match, std::string_view etag);
+
+// A stable 64-bit FNV-1a hash, used to derive entity tags.
+std::uint64_t Fnv1aHash(std::string_view data);
+
+} // namespace utils
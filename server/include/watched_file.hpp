@@ -0,0 +1,67 @@
+#pragma once
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace server {
+
+// Holds an immutable file written by the indexer, opened as a `T` that is
+// constructed from its path and throws if the file is invalid. The indexer
+// replaces such files by renaming a new one over them, so a change of
+// modification time means there is a new file to open. Readers holding the
+// previous `T` keep it until they are done with it.
+template <typename T> class WatchedFile {
+public:
+    explicit WatchedFile(std::string path) : path(std::move(path)) {}
+
+    // Opens the file again if it has changed since it was last opened, or
+    // failed to open. Returns false if none is available.
+    bool Refresh() {
+        std::error_code error;
+        auto current_write_time = std::filesystem::last_write_time(path, error);
+        if (error) {
+            return Get() != nullptr; // Keep serving what is already open
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            if (current_write_time == last_write_time) {
+                return value != nullptr;
+            }
+        }
+
+        try {
+            auto new_value = std::make_shared<const T>(path);
+            std::cout << "Opened " << path << std::endl;
+            std::lock_guard lock(mutex);
+            value = std::move(new_value);
+            last_write_time = current_write_time;
+            return true;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            std::lock_guard lock(mutex);
+            last_write_time = current_write_time; // Do not retry until it changes
+            return value != nullptr;
+        }
+    }
+
+    // Returns what was opened last, or null if nothing was.
+    std::shared_ptr<const T> Get() const {
+        std::lock_guard lock(mutex);
+        return value;
+    }
+
+private:
+    std::string path;
+
+    mutable std::mutex mutex;
+    std::shared_ptr<const T> value;
+    // Of the file last opened, or that failed to open; none before the first
+    // attempt
+    std::optional<std::filesystem::file_time_type> last_write_time;
+};
+
+} // namespace server
@@ -0,0 +1,158 @@
+#include "assets.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include "utils.hpp"
+
+namespace server {
+
+namespace {
+
+std::string readFile(const std::string &file_path) {
+    std::ifstream ifs(file_path, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("Failed to open file: " + file_path);
+    }
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+std::filesystem::file_time_type getLastWriteTime(const std::string &file_path) {
+    std::error_code error;
+    auto last_write_time = std::filesystem::last_write_time(file_path, error);
+    return error ? std::filesystem::file_time_type::min() : last_write_time;
+}
+
+} // namespace
+
+StaticPage::StaticPage(std::string file_path, std::string content_type, bool watch_for_changes)
+    : file_path(std::move(file_path)), content_type(std::move(content_type)),
+      watch_for_changes(watch_for_changes) {
+    last_write_time = getLastWriteTime(this->file_path);
+    variants = load();
+}
+
+void StaticPage::Serve(const httplib::Request &req, httplib::Response &res) {
+    std::shared_ptr<const Variants> current = currentVariants();
+
+    const std::string &accept_encoding = req.get_header_value("Accept-Encoding");
+    const Encoding *encoding = &current->identity;
+    const char *encoding_name = nullptr;
+    if (!current->brotli.body.empty() && utils::AcceptsEncoding(accept_encoding, "br")) {
+        encoding = &current->brotli;
+        encoding_name = "br";
+    } else if (!current->gzip.body.empty() && utils::AcceptsEncoding(accept_encoding, "gzip")) {
+        encoding = &current->gzip;
+        encoding_name = "gzip";
+    }
+
+    // no-cache makes clients revalidate, which costs them a 304 at most
+    res.set_header("ETag", encoding->etag);
+    res.set_header("Vary", "Accept-Encoding");
+    res.set_header("Cache-Control", "no-cache");
+
+    if (req.has_header("If-None-Match") &&
+        utils::MatchesEtag(req.get_header_value("If-None-Match"), encoding->etag)) {
+        res.status = 304;
+        return;
+    }
+
+    if (encoding_name) {
+        res.set_header("Content-Encoding", encoding_name);
+    }
+    res.set_content(encoding->body, content_type);
+}
+
+// Private methods
+
+std::shared_ptr<const StaticPage::Variants> StaticPage::currentVariants() {
+    if (!watch_for_changes) {
+        return variants; // Never replaced
+    }
+
+    auto current_write_time = getLastWriteTime(file_path);
+    {
+        std::shared_lock lock(mutex);
+        if (current_write_time == last_write_time) {
+            return variants;
+        }
+    }
+
+    std::unique_lock lock(mutex);
+    if (current_write_time != last_write_time) {
+        try {
+            variants = load();
+            std::cout << "Reloaded " << file_path << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+        last_write_time = current_write_time;
+    }
+    return variants;
+}
+
+std::shared_ptr<const StaticPage::Variants> StaticPage::load() {
+    auto loaded = std::make_shared<Variants>();
+    loaded->identity.body = readFile(file_path);
+
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx",
+                  static_cast<unsigned long long>(utils::Fnv1aHash(loaded->identity.body)));
+    // Each encoding is a different representation, so it gets its own tag
+    loaded->identity.etag = "\"" + std::string(hash) + "\"";
+
+    std::string gzip = utils::GzipCompress(loaded->identity.body);
+    if (!gzip.empty() && gzip.size() < loaded->identity.body.size()) {
+        loaded->gzip = {.body = std::move(gzip), .etag = "\"" + std::string(hash) + "-gzip\""};
+    }
+    std::string brotli = utils::BrotliCompress(loaded->identity.body);
+    if (!brotli.empty() && brotli.size() < loaded->identity.body.size()) {
+        loaded->brotli = {.body = std::move(brotli), .etag = "\"" + std::string(hash) + "-br\""};
+    }
+    return loaded;
+}
+
+TemplateFile::TemplateFile(inja::Environment &env, std::string file_path, bool watch_for_changes)
+    : env(env), file_path(std::move(file_path)), watch_for_changes(watch_for_changes) {
+    last_write_time = getLastWriteTime(this->file_path);
+    parsed_template = env.parse_template(this->file_path);
+}
+
+std::string TemplateFile::Render(const nlohmann::json &data) {
+    if (!watch_for_changes) {
+        return env.render(parsed_template, data); // Never replaced
+    }
+
+    reloadIfChanged();
+    std::shared_lock lock(mutex);
+    return env.render(parsed_template, data);
+}
+
+// Private methods
+
+void TemplateFile::reloadIfChanged() {
+    auto current_write_time = getLastWriteTime(file_path);
+    {
+        std::shared_lock lock(mutex);
+        if (current_write_time == last_write_time) {
+            return;
+        }
+    }
+
+    std::unique_lock lock(mutex);
+    if (current_write_time != last_write_time) {
+        // Keep rendering the previous version if the new one does not parse
+        try {
+            parsed_template = env.parse_template(file_path);
+            std::cout << "Reloaded " << file_path << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to reload " << file_path << ": " << e.what() << std::endl;
+        }
+        last_write_time = current_write_time;
+    }
+}
+
+} // namespace server
@@ -2,6 +2,20 @@
 #include <nlohmann/json.hpp>
 #include "inja/inja.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "assets.hpp"
+#include "result_cache.hpp"
+#include "search_index.hpp"
+#include "segment_index.hpp"
+#include "suggest_index.hpp"
+#include "utils.hpp"
+
 // These are needed to convert the CMake macro to a C++ string
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
@@ -9,6 +23,51 @@
 // Use nlohmann::json for convenience
 using json = nlohmann::json;
 
+// Number of results shown on a results page
+constexpr int kResultsPerPage = 10;
+
+// Largest page of results /api/search returns
+constexpr int kMaxApiResultsPerPage = 100;
+
+// Number of completions returned by /suggest
+constexpr std::size_t kSuggestionCount = 8;
+
+namespace {
+
+// Returns the value of an integer query parameter, or `fallback` if it is
+// missing or not an integer.
+int getIntParam(const httplib::Request &req, const std::string &name, int fallback) {
+    if (!req.has_param(name)) {
+        return fallback;
+    }
+    std::string text = req.get_param_value(name);
+    int value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size() ? value : fallback;
+}
+
+std::optional<server::SearchCursor> getCursorParam(const httplib::Request &req) {
+    return req.has_param("after") ? server::ParseCursor(req.get_param_value("after"))
+                                  : std::nullopt;
+}
+
+json toJson(const server::SearchResult &result) {
+    json highlights = json::array();
+    for (const indexer::Highlight &highlight : result.snippet.highlights) {
+        highlights.push_back({highlight.begin, highlight.end});
+    }
+    return {{"url", result.url},
+            {"title", result.title},
+            {"snippet", {{"text", result.snippet.text}, {"highlights", std::move(highlights)}}},
+            {"cursor", server::EncodeCursor(result.cursor)}};
+}
+
+} // namespace
+
+// How often the index generation and the segment file are checked, to
+// invalidate cached results and to pick up a rebuilt segment
+constexpr auto kGenerationPollInterval = std::chrono::milliseconds(500);
+
 int main(void) {
     // Create the server instance (like ServeMux)
     httplib::Server svr;
@@ -20,27 +79,203 @@ int main(void) {
 
     // Get the path to static files from the CMake definition
     const std::string static_path = TOSTRING(STATIC_FILE_PATH);
+
+    // Pages and templates are loaded once; in dev mode they are reloaded
+    // when they change on disk
+    const bool dev_mode = SEARCHLIGHT_DEV_MODE;
+    server::StaticPage index_page(static_path + "/index.html", "text/html", dev_mode);
+    server::TemplateFile results_template(env, static_path + "/results.html", dev_mode);
+
+    // One connection per worker thread, so that searches run in parallel
+    server::SearchIndex search_index(DB_PATH, FTS_HTML_EXT_PATH, DB_MMAP_SIZE_MB,
+                                     CPPHTTPLIB_THREAD_POOL_COUNT);
+
+    // The native index, if the indexer has built one, is searched instead of
+    // FTS5. It is mapped, not read.
+    server::SegmentIndex segment_index(std::string(INDEX_PATH) + "/webpages.seg");
+
+    // Completions come from a trie the indexer builds along with the segment
+    server::SuggestIndex suggest_index(std::string(INDEX_PATH) + "/webpages.sug");
+
+    // Results are cached until what they were computed from changes: the
+    // segment if there is one, the database otherwise. This is checked in
+    // the background so that cache hits never touch either. Which of the two
+    // answered is part of the cache key, as a segment is tagged with the
+    // generation of the database it was built from.
+    server::ResultCache result_cache(static_cast<std::size_t>(RESULT_CACHE_SIZE_MB) * 1024 * 1024);
+    auto refreshGeneration = [&]() {
+        suggest_index.Refresh();
+        if (segment_index.Refresh()) {
+            result_cache.SetGeneration(segment_index.GetSegment()->GetSourceGeneration());
+        } else {
+            result_cache.SetGeneration(search_index.GetGeneration());
+        }
+    };
+    refreshGeneration();
+    std::jthread generation_watcher([&](std::stop_token stop_token) {
+        while (!stop_token.stop_requested()) {
+            std::this_thread::sleep_for(kGenerationPollInterval);
+            refreshGeneration();
+        }
+    });
     
-    svr.Get("/", [&](const httplib::Request &, httplib::Response &res) {
-        // Use the static_path to build the full file path
-        std::ifstream ifs(static_path + "/index.html");
-        std::string content((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
-        res.set_content(content, "text/html");
+    svr.Get("/", [&](const httplib::Request &req, httplib::Response &res) {
+        index_page.Serve(req, res);
     });
     
+    // Returns a page of results for the query, from the cache if it has it,
+    // or null if search is unavailable. A cursor of the backend that is not
+    // searched now, which switched since the previous page, is dropped, so
+    // the results start over from the first page.
+    auto search = [&](const std::string &query, std::optional<server::SearchCursor> &after,
+                      int limit) -> server::ResultCache::Results {
+        server::SearchBackend backend = segment_index.GetSegment()
+                                            ? server::SearchBackend::kSegment
+                                            : server::SearchBackend::kFts;
+        if (after && after->backend != backend) {
+            after.reset();
+        }
+        std::string cache_key = server::ResultCache::NormalizeKey(
+            backend, query, after ? server::EncodeCursor(*after) : "", limit);
+        server::ResultCache::Results results = result_cache.Lookup(cache_key);
+        if (results) {
+            return results;
+        }
+
+        std::uint64_t generation = result_cache.GetGeneration();
+        auto found = segment_index.Search(query, limit, after);
+        // The segment may have been opened since the key was made
+        bool is_cacheable = found.has_value() == (backend == server::SearchBackend::kSegment);
+        if (!found.has_value()) {
+            found = search_index.Search(query, limit, after);
+        }
+        if (!found.has_value()) {
+            return nullptr;
+        }
+        results = std::make_shared<const std::vector<server::SearchResult>>(std::move(*found));
+        if (is_cacheable) {
+            result_cache.Insert(cache_key, results, generation);
+        }
+        return results;
+    };
+
     svr.Get("/search", [&](const httplib::Request &req, httplib::Response &res) {
-        // Get the query param "q"
+        // Get the query param "q", and where the page starts if it is not the
+        // first one
         std::string query = req.has_param("q") ? req.get_param_value("q") : "";
+        std::optional<server::SearchCursor> after = getCursorParam(req);
+
+        server::ResultCache::Results results = search(query, after, kResultsPerPage);
+        if (!results) {
+            res.status = 500;
+            res.set_content("Search is unavailable, please try again later.", "text/plain");
+            return;
+        }
+        int page = after ? std::max(2, getIntParam(req, "page", 2)) : 1;
 
-        // --- SQLite FTS5 logic would go here ---
         json data;
-        data["query"] = query;
-        data["results"] = {"First result for '" + query + "'", "Second result!", "Third..."};
-        
+        data["query"] = utils::EscapeHtml(query);
+        data["page"] = page;
+        data["results"] = json::array();
+        for (const auto &result : *results) {
+            data["results"].push_back({{"url", utils::EscapeHtml(result.url)},
+                                       {"title", utils::EscapeHtml(result.title.empty() ? result.url
+                                                                                        : result.title)},
+                                       {"snippet", utils::RenderSnippet(result.snippet)}});
+        }
+
+        // A full page may be followed by another, which resumes after its
+        // last result
+        data["next_url"] = nullptr;
+        if (results->size() == static_cast<std::size_t>(kResultsPerPage)) {
+            data["next_url"] = utils::EscapeHtml(
+                "/search?q=" + utils::EncodeQueryParam(query) + "&page=" + std::to_string(page + 1) +
+                "&after=" + server::EncodeCursor(results->back().cursor));
+        }
+
         // Render the template
-        std::string result = env.render_file(static_path + "/results.html", data);
+        std::string result = results_template.Render(data);
         
-        res.set_content(result, "text/html");
+        res.set_content(std::move(result), "text/html");
+    });
+
+    // The same search as JSON, for clients. Results are written out one at a
+    // time as chunks, so the first ones are sent before the rest are
+    // serialized and no request holds a whole serialized page.
+    svr.Get("/api/search", [&](const httplib::Request &req, httplib::Response &res) {
+        std::string query = req.has_param("q") ? req.get_param_value("q") : "";
+        int limit = std::clamp(getIntParam(req, "limit", kResultsPerPage), 1, kMaxApiResultsPerPage);
+
+        std::optional<server::SearchCursor> after = getCursorParam(req);
+        server::ResultCache::Results results = search(query, after, limit);
+        if (!results) {
+            res.status = 500;
+            res.set_content(R"({"error":"Search is unavailable, please try again later."})",
+                            "application/json");
+            return;
+        }
+
+        auto dump = [](const json &value) {
+            return value.dump(-1, ' ', false, json::error_handler_t::replace);
+        };
+        json next = nullptr;
+        if (results->size() == static_cast<std::size_t>(limit)) {
+            next = server::EncodeCursor(results->back().cursor);
+        }
+        std::string head = R"({"query":)" + dump(query) + R"(,"results":[)";
+        std::string tail = R"(],"next":)" + dump(next) + "}";
+
+        res.set_chunked_content_provider(
+            "application/json",
+            [results, head = std::move(head), tail = std::move(tail), dump,
+             next_result = std::size_t{0}](std::size_t, httplib::DataSink &sink) mutable {
+                std::string chunk;
+                if (next_result == 0) {
+                    chunk = head;
+                }
+                if (next_result < results->size()) {
+                    if (next_result > 0) {
+                        chunk += ',';
+                    }
+                    chunk += dump(toJson((*results)[next_result++]));
+                    return sink.write(chunk.data(), chunk.size());
+                }
+                chunk += tail;
+                if (!sink.write(chunk.data(), chunk.size())) {
+                    return false;
+                }
+                sink.done();
+                return true;
+            });
+    });
+
+    svr.Get("/suggest", [&](const httplib::Request &req, httplib::Response &res) {
+        std::string query = req.has_param("q") ? req.get_param_value("q") : "";
+        json data;
+        data["query"] = query;
+        data["suggestions"] = suggest_index.Suggest(query, kSuggestionCount);
+        res.set_content(data.dump(-1, ' ', false, json::error_handler_t::replace),
+                        "application/json");
+    });
+
+    svr.Get("/stats", [&](const httplib::Request &, httplib::Response &res) {
+        server::ResultCache::Stats stats = result_cache.GetStats();
+        json data;
+        data["result_cache"] = {{"hits", stats.hits},
+                                {"misses", stats.misses},
+                                {"entries", stats.entry_count},
+                                {"memory_usage", stats.memory_usage},
+                                {"generation", stats.generation.has_value()
+                                                   ? json(*stats.generation)
+                                                   : json(nullptr)}};
+        if (auto segment = segment_index.GetSegment()) {
+            data["segment"] = {{"documents", segment->GetDocCount()},
+                               {"terms", segment->GetTermCount()},
+                               {"generation", segment->GetSourceGeneration()}};
+        } else {
+            data["segment"] = nullptr;
+        }
+        res.set_content(data.dump(), "application/json");
     });
 
     std::cout << "Server listening on http://localhost:8080" << std::endl;
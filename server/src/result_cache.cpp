@@ -0,0 +1,141 @@
+#include "result_cache.hpp"
+
+#include <functional>
+
+namespace server {
+
+namespace {
+
+// Rough cost of the list node, the index node and the allocations of an
+// entry, on top of the characters it holds
+constexpr std::size_t kEntryOverhead = 128;
+
+std::size_t estimateSize(const std::string &key, const std::vector<SearchResult> &results) {
+    std::size_t size = kEntryOverhead + key.size() + results.size() * sizeof(SearchResult);
+    for (const SearchResult &result : results) {
+        size += result.url.capacity() + result.title.capacity() + result.snippet.text.capacity() +
+                result.snippet.highlights.capacity() * sizeof(indexer::Highlight);
+    }
+    return size;
+}
+
+} // namespace
+
+ResultCache::ResultCache(std::size_t memory_limit_bytes)
+    : shard_memory_limit(memory_limit_bytes / kShardCount) {}
+
+ResultCache::Results ResultCache::Lookup(const std::string &key) {
+    std::uint64_t current_generation = generation.load(std::memory_order_acquire);
+    if (current_generation != kDisabledGeneration) {
+        Shard &shard = getShard(key);
+        std::lock_guard lock(shard.mutex);
+        if (auto it = shard.index.find(key); it != shard.index.end()) {
+            if (it->second->generation == current_generation) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return it->second->results;
+            }
+            erase(shard, it->second); // Stale
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void ResultCache::Insert(const std::string &key, Results results, std::uint64_t generation) {
+    if (generation == kDisabledGeneration ||
+        generation != this->generation.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::size_t size = estimateSize(key, *results);
+    if (size > shard_memory_limit) {
+        return;
+    }
+
+    Shard &shard = getShard(key);
+    std::lock_guard lock(shard.mutex);
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        erase(shard, it->second);
+    }
+    while (!shard.entries.empty() && shard.memory_usage + size > shard_memory_limit) {
+        erase(shard, std::prev(shard.entries.end()));
+    }
+
+    shard.entries.push_front(
+        Entry{.key = key, .results = std::move(results), .generation = generation, .size = size});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.memory_usage += size;
+}
+
+std::uint64_t ResultCache::GetGeneration() const {
+    return generation.load(std::memory_order_acquire);
+}
+
+void ResultCache::SetGeneration(std::optional<std::uint64_t> generation) {
+    // Stale entries are dropped lazily, when they are looked up or evicted
+    this->generation.store(generation.value_or(kDisabledGeneration), std::memory_order_release);
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+    Stats stats{.hits = hits.load(std::memory_order_relaxed),
+                .misses = misses.load(std::memory_order_relaxed),
+                .entry_count = 0,
+                .memory_usage = 0,
+                .generation = std::nullopt};
+    if (std::uint64_t current_generation = GetGeneration();
+        current_generation != kDisabledGeneration) {
+        stats.generation = current_generation;
+    }
+    for (const Shard &shard : shards) {
+        std::lock_guard lock(shard.mutex);
+        stats.entry_count += shard.entries.size();
+        stats.memory_usage += shard.memory_usage;
+    }
+    return stats;
+}
+
+std::string ResultCache::NormalizeKey(SearchBackend backend, std::string_view query,
+                                      std::string_view cursor, int limit) {
+    // Words are separated by single spaces and lowercased, as every search
+    // backend folds ASCII case, except for the OR operator
+    std::string key;
+    std::size_t i = 0;
+    while (i < query.size()) {
+        std::size_t end = query.find_first_of(" \t\n\r\f\v", i);
+        if (end == std::string_view::npos) {
+            end = query.size();
+        }
+        std::string_view word = query.substr(i, end - i);
+        if (!word.empty()) {
+            if (!key.empty()) {
+                key += ' ';
+            }
+            for (char c : word) {
+                key += (c >= 'A' && c <= 'Z' && word != "OR") ? c + ('a' - 'A') : c;
+            }
+        }
+        i = end + 1;
+    }
+    key += '\0';
+    key += cursor;
+    key += '\0';
+    key += std::to_string(limit);
+    key += backend == SearchBackend::kSegment ? 's' : 'f';
+    return key;
+}
+
+// Private methods
+
+ResultCache::Shard &ResultCache::getShard(std::string_view key) {
+    return shards[std::hash<std::string_view>{}(key) % kShardCount];
+}
+
+void ResultCache::erase(Shard &shard, std::list<Entry>::iterator it) {
+    shard.memory_usage -= it->size;
+    shard.index.erase(it->key);
+    shard.entries.erase(it);
+}
+
+} // namespace server
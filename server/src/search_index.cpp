@@ -0,0 +1,316 @@
+#include "search_index.hpp"
+
+#include <sqlite3.h>
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "tokenizer.hpp"
+
+namespace server {
+
+namespace {
+
+struct SQLiteDbDeleter {
+    void operator()(sqlite3 *db) const { sqlite3_close_v2(db); }
+};
+
+struct SQLiteStmtDeleter {
+    void operator()(sqlite3_stmt *stmt) const { sqlite3_finalize(stmt); }
+};
+
+// `rank` is bm25(webpages) unless configured otherwise, lower being better.
+// Pages are ordered by rank and then rowid, so that a page of results can
+// resume after the (rank, rowid) of the last result of the previous one
+// (?2 and ?3, or NULL for the first page). The inner query only ranks
+// pages; snippet() is then called for the `limit` it keeps rather than for
+// every match, which the sort would otherwise do. It marks the matched
+// terms of the content column with control characters, which cannot
+// appear in the text of a page.
+constexpr const char *kSearchQuery =
+    "SELECT url, title, snippet(webpages, 2, char(1), char(2), '…', 24), rowid, rank "
+    "FROM webpages WHERE webpages MATCH ?1 AND rowid IN ("
+    "SELECT rowid FROM webpages WHERE webpages MATCH ?1 "
+    "AND (?2 IS NULL OR rank > ?2 OR (rank = ?2 AND rowid > ?3)) "
+    "ORDER BY rank, rowid LIMIT ?4) "
+    "ORDER BY rank, rowid;";
+
+constexpr char kHighlightBegin = '\x01';
+constexpr char kHighlightEnd = '\x02';
+
+// Snippets of the content column are cut out of its HTML, so they are
+// turned into text before the markers are taken out.
+indexer::Snippet parseSnippet(std::string_view marked_html) {
+    std::string marked_text = indexer::CompactText(indexer::ExtractText(marked_html), SIZE_MAX);
+    indexer::Snippet snippet;
+    snippet.text.reserve(marked_text.size());
+    for (char c : marked_text) {
+        if (c == kHighlightBegin) {
+            auto offset = static_cast<std::uint32_t>(snippet.text.size());
+            snippet.highlights.push_back({offset, offset});
+        } else if (c == kHighlightEnd) {
+            if (!snippet.highlights.empty()) {
+                snippet.highlights.back().end = static_cast<std::uint32_t>(snippet.text.size());
+            }
+        } else {
+            snippet.text += c;
+        }
+    }
+    return snippet;
+}
+
+constexpr const char *kGenerationQuery = "SELECT generation FROM index_generation WHERE id = 0;";
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+} // namespace
+
+struct SearchIndex::Connection {
+    std::unique_ptr<sqlite3, SQLiteDbDeleter> db;
+    std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> search_stmt;
+    // Null if the crawler has not created the generation table yet
+    std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter> generation_stmt;
+};
+
+SearchIndex::SearchIndex(const std::string &db_path, const std::string &fts_html_ext_path,
+                         int mmap_size_mb, std::size_t connection_count)
+    : db_path(db_path), fts_html_ext_path(fts_html_ext_path), mmap_size_mb(mmap_size_mb) {
+    // Open every connection now so that no request pays for open or prepare
+    idle_connections.reserve(connection_count);
+    for (std::size_t i = 0; i < connection_count; ++i) {
+        idle_connections.push_back(openConnection());
+    }
+}
+
+SearchIndex::~SearchIndex() = default;
+
+std::optional<std::vector<SearchResult>> SearchIndex::Search(std::string_view query, int limit,
+                                                             std::optional<SearchCursor> after) {
+    std::string match_expression = BuildMatchExpression(query);
+    if (match_expression.empty()) {
+        return std::vector<SearchResult>();
+    }
+
+    std::unique_ptr<Connection> connection = acquireConnection();
+    if (!connection) {
+        return std::nullopt;
+    }
+
+    sqlite3_stmt *stmt = connection->search_stmt.get();
+    sqlite3_bind_text(stmt, 1, match_expression.data(), static_cast<int>(match_expression.size()),
+                      SQLITE_STATIC);
+    if (after && after->backend == SearchBackend::kFts) {
+        sqlite3_bind_double(stmt, 2, after->score);
+        sqlite3_bind_int64(stmt, 3, after->doc_id);
+    }
+    sqlite3_bind_int(stmt, 4, limit);
+
+    std::vector<SearchResult> results;
+    int result_code;
+    while ((result_code = sqlite3_step(stmt)) == SQLITE_ROW) {
+        SearchResult &result = results.emplace_back();
+        if (auto url = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))) {
+            result.url.assign(url, sqlite3_column_bytes(stmt, 0));
+        }
+        if (auto title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1))) {
+            result.title.assign(title, sqlite3_column_bytes(stmt, 1));
+        }
+        if (auto snippet = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2))) {
+            result.snippet = parseSnippet(std::string_view(snippet, sqlite3_column_bytes(stmt, 2)));
+        }
+        result.cursor = {.backend = SearchBackend::kFts,
+                         .score = sqlite3_column_double(stmt, 4),
+                         .doc_id = sqlite3_column_int64(stmt, 3)};
+    }
+
+    bool is_done = result_code == SQLITE_DONE;
+    if (!is_done) {
+        std::cerr << "Search failed: " << sqlite3_errmsg(connection->db.get()) << std::endl;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    releaseConnection(std::move(connection));
+
+    if (!is_done) {
+        return std::nullopt;
+    }
+    return results;
+}
+
+std::optional<std::uint64_t> SearchIndex::GetGeneration() {
+    std::unique_ptr<Connection> connection = acquireConnection();
+    if (!connection) {
+        return std::nullopt;
+    }
+
+    if (!connection->generation_stmt) {
+        // Try again, the crawler may have created the table since
+        sqlite3_stmt *raw_stmt = nullptr;
+        if (sqlite3_prepare_v3(connection->db.get(), kGenerationQuery, -1,
+                               SQLITE_PREPARE_PERSISTENT, &raw_stmt, nullptr) != SQLITE_OK) {
+            releaseConnection(std::move(connection));
+            return std::nullopt;
+        }
+        connection->generation_stmt.reset(raw_stmt);
+    }
+
+    sqlite3_stmt *stmt = connection->generation_stmt.get();
+    std::optional<std::uint64_t> generation;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        generation = static_cast<std::uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_reset(stmt);
+    releaseConnection(std::move(connection));
+    return generation;
+}
+
+// Private methods
+
+std::unique_ptr<SearchIndex::Connection> SearchIndex::openConnection() const {
+    auto connection = std::make_unique<Connection>();
+
+    // Each connection is used by one thread at a time and keeps its own page
+    // cache, so SQLite's own locking and the shared cache are left out.
+    sqlite3 *raw_db_handle = nullptr;
+    int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
+    int result_code = sqlite3_open_v2(db_path.c_str(), &raw_db_handle, flags, nullptr);
+    connection->db.reset(raw_db_handle);
+    if (result_code != SQLITE_OK) {
+        throw std::runtime_error("Failed to open SQLite database: " +
+                                 std::string(sqlite3_errmsg(raw_db_handle)));
+    }
+    sqlite3 *db = connection->db.get();
+
+    // The tokenizer of the FTS table is needed to tokenize queries. Loading
+    // is only enabled for the C API, not for the load_extension() function.
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, nullptr);
+    char *err_msg = nullptr;
+    if (sqlite3_load_extension(db, fts_html_ext_path.c_str(), nullptr, &err_msg) != SQLITE_OK) {
+        std::string error_msg = err_msg ? err_msg : "Unknown error";
+        sqlite3_free(err_msg);
+        throw std::runtime_error("Failed to load FTS HTML extension: " + error_msg);
+    }
+
+    // The crawler puts the database in WAL mode, which is persistent, so
+    // these readers run alongside its writes.
+    std::string pragmas = "PRAGMA query_only=1;"
+                          "PRAGMA mmap_size=" +
+                          std::to_string(static_cast<long long>(mmap_size_mb) * 1024 * 1024) + ";";
+    if (sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::string error_msg = err_msg ? err_msg : "Unknown error";
+        sqlite3_free(err_msg);
+        throw std::runtime_error("Failed to configure SQLite database: " + error_msg);
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    sqlite3_stmt *raw_stmt = nullptr;
+    if (sqlite3_prepare_v3(db, kSearchQuery, -1, SQLITE_PREPARE_PERSISTENT, &raw_stmt, nullptr) !=
+        SQLITE_OK) {
+        throw std::runtime_error("Failed to prepare SQLite statement: " +
+                                 std::string(sqlite3_errmsg(db)));
+    }
+    connection->search_stmt.reset(raw_stmt);
+
+    return connection;
+}
+
+std::unique_ptr<SearchIndex::Connection> SearchIndex::acquireConnection() {
+    {
+        std::lock_guard lock(pool_mutex);
+        if (!idle_connections.empty()) {
+            std::unique_ptr<Connection> connection = std::move(idle_connections.back());
+            idle_connections.pop_back();
+            return connection;
+        }
+    }
+
+    // More concurrent searches than expected: grow the pool
+    try {
+        return openConnection();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void SearchIndex::releaseConnection(std::unique_ptr<Connection> connection) {
+    std::lock_guard lock(pool_mutex);
+    idle_connections.push_back(std::move(connection));
+}
+
+std::string BuildMatchExpression(std::string_view query) {
+    std::string expression;
+    std::size_t i = 0;
+    while (i < query.size()) {
+        while (i < query.size() && isSpace(query[i])) {
+            ++i;
+        }
+        if (i == query.size()) {
+            break;
+        }
+
+        if (!expression.empty()) {
+            expression += ' ';
+        }
+        expression += '"';
+        while (i < query.size() && !isSpace(query[i])) {
+            if (query[i] == '"') {
+                expression += '"';
+            }
+            expression += query[i++];
+        }
+        expression += '"';
+    }
+    return expression;
+}
+
+std::string EncodeCursor(const SearchCursor &cursor) {
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "%c%016llx.%lld",
+                  cursor.backend == SearchBackend::kSegment ? 's' : 'f',
+                  static_cast<unsigned long long>(std::bit_cast<std::uint64_t>(cursor.score)),
+                  static_cast<long long>(cursor.doc_id));
+    return buffer;
+}
+
+std::optional<SearchCursor> ParseCursor(std::string_view text) {
+    SearchCursor cursor{};
+    if (text.starts_with('f')) {
+        cursor.backend = SearchBackend::kFts;
+    } else if (text.starts_with('s')) {
+        cursor.backend = SearchBackend::kSegment;
+    } else {
+        return std::nullopt;
+    }
+    text.remove_prefix(1);
+
+    std::size_t separator = text.find('.');
+    if (separator != 16) {
+        return std::nullopt;
+    }
+    std::uint64_t score_bits = 0;
+    const char *end = text.data() + text.size();
+    auto [score_end, score_error] =
+        std::from_chars(text.data(), text.data() + separator, score_bits, 16);
+    auto [doc_end, doc_error] =
+        std::from_chars(text.data() + separator + 1, end, cursor.doc_id);
+    if (score_error != std::errc() || score_end != text.data() + separator ||
+        doc_error != std::errc() || doc_end != end) {
+        return std::nullopt;
+    }
+    cursor.score = std::bit_cast<double>(score_bits);
+    if (std::isnan(cursor.score)) {
+        return std::nullopt;
+    }
+    return cursor;
+}
+
+} // namespace server
@@ -0,0 +1,71 @@
+#include "segment_index.hpp"
+
+#include <chrono>
+
+#include "query.hpp"
+#include "searcher.hpp"
+
+namespace server {
+
+namespace {
+
+// Time a result may spend on its snippet before settling for the start of
+// its text, so that a few long pages cannot slow a whole page of results
+constexpr auto kSnippetTimeBudget = std::chrono::microseconds(500);
+
+} // namespace
+
+SegmentIndex::SegmentIndex(std::string segment_path) : segment(std::move(segment_path)) {}
+
+bool SegmentIndex::Refresh() {
+    return segment.Refresh();
+}
+
+std::shared_ptr<const indexer::Segment> SegmentIndex::GetSegment() const {
+    return segment.Get();
+}
+
+std::optional<std::vector<SearchResult>>
+SegmentIndex::Search(std::string_view query, int limit, std::optional<SearchCursor> after) const {
+    std::shared_ptr<const indexer::Segment> current_segment = GetSegment();
+    if (!current_segment) {
+        return std::nullopt;
+    }
+
+    indexer::Query parsed_query = indexer::Query::Parse(query);
+    // Scores are floats, which the double of a cursor holds exactly
+    std::optional<indexer::ScoredDoc> after_doc;
+    if (after && after->backend == SearchBackend::kSegment) {
+        if (after->doc_id < 0 || after->doc_id >= current_segment->GetDocCount()) {
+            return std::vector<SearchResult>();
+        }
+        after_doc = indexer::ScoredDoc{.doc_id = static_cast<std::uint32_t>(after->doc_id),
+                                       .score = static_cast<float>(after->score)};
+    }
+
+    indexer::Searcher searcher(*current_segment);
+    std::vector<indexer::ScoredDoc> top_docs =
+        searcher.Search(parsed_query, static_cast<std::size_t>(limit), after_doc);
+
+    std::vector<std::uint32_t> doc_ids;
+    doc_ids.reserve(top_docs.size());
+    for (const indexer::ScoredDoc &scored_doc : top_docs) {
+        doc_ids.push_back(scored_doc.doc_id);
+    }
+    std::vector<indexer::Snippet> snippets =
+        indexer::MakeSnippets(*current_segment, parsed_query, doc_ids, kSnippetTimeBudget);
+
+    std::vector<SearchResult> results;
+    results.reserve(top_docs.size());
+    for (std::size_t i = 0; i < doc_ids.size(); ++i) {
+        results.push_back({.url = std::string(current_segment->GetUrl(doc_ids[i])),
+                           .title = std::string(current_segment->GetTitle(doc_ids[i])),
+                           .snippet = std::move(snippets[i]),
+                           .cursor = {.backend = SearchBackend::kSegment,
+                                      .score = top_docs[i].score,
+                                      .doc_id = doc_ids[i]}});
+    }
+    return results;
+}
+
+} // namespace server
@@ -0,0 +1,43 @@
+#include "suggest_index.hpp"
+
+#include "tokenizer.hpp"
+
+namespace server {
+
+SuggestIndex::SuggestIndex(std::string trie_path) : trie(std::move(trie_path)) {}
+
+bool SuggestIndex::Refresh() {
+    return trie.Refresh();
+}
+
+std::vector<std::string> SuggestIndex::Suggest(std::string_view query, std::size_t limit) const {
+    std::shared_ptr<const indexer::CompletionTrie> current_trie = trie.Get();
+    if (!current_trie) {
+        return {};
+    }
+
+    // The last word may still be being typed; the words before it are kept
+    // as they are
+    std::size_t word_start = query.size();
+    while (word_start > 0 && indexer::IsTokenChar(query[word_start - 1])) {
+        --word_start;
+    }
+    std::size_t word_length = query.size() - word_start;
+    if (word_length == 0 || word_length > indexer::kMaxTokenLength) {
+        return {};
+    }
+
+    // Terms are lowercase, as in the index
+    std::string prefix(query.substr(word_start));
+    for (char &c : prefix) {
+        c = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    std::vector<std::string> suggestions;
+    for (const indexer::Completion &completion : current_trie->Complete(prefix, limit)) {
+        suggestions.push_back(std::string(query.substr(0, word_start)) + completion.term);
+    }
+    return suggestions;
+}
+
+} // namespace server
@@ -0,0 +1,203 @@
+#include "utils.hpp"
+
+#include <cstdlib>
+#include <optional>
+#include <zlib.h>
+#ifdef SEARCHLIGHT_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+    std::size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    std::size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        char lower_a = (a[i] >= 'A' && a[i] <= 'Z') ? a[i] + ('a' - 'A') : a[i];
+        char lower_b = (b[i] >= 'A' && b[i] <= 'Z') ? b[i] + ('a' - 'A') : b[i];
+        if (lower_a != lower_b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Calls `visit` with each trimmed element of a comma-separated header value
+// until it returns true.
+template <typename Visitor> bool anyListElement(std::string_view list, Visitor visit) {
+    while (!list.empty()) {
+        std::size_t comma = list.find(',');
+        if (visit(trim(list.substr(0, comma)))) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+} // namespace
+
+std::string EscapeHtml(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+        case '&':
+            escaped += "&amp;";
+            break;
+        case '<':
+            escaped += "&lt;";
+            break;
+        case '>':
+            escaped += "&gt;";
+            break;
+        case '"':
+            escaped += "&quot;";
+            break;
+        case '\'':
+            escaped += "&#39;";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string EncodeQueryParam(std::string_view text) {
+    static constexpr char kHexDigits[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(text.size());
+    for (unsigned char c : text) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '.' || c == '_' || c == '~') {
+            encoded += static_cast<char>(c);
+        } else {
+            encoded += '%';
+            encoded += kHexDigits[c >> 4];
+            encoded += kHexDigits[c & 0xF];
+        }
+    }
+    return encoded;
+}
+
+std::string RenderSnippet(const indexer::Snippet &snippet) {
+    std::string_view text = snippet.text;
+    std::string html;
+    std::size_t offset = 0;
+    for (const indexer::Highlight &highlight : snippet.highlights) {
+        if (highlight.begin < offset || highlight.end > text.size()) {
+            continue;
+        }
+        html += EscapeHtml(text.substr(offset, highlight.begin - offset));
+        html += "<mark>";
+        html += EscapeHtml(text.substr(highlight.begin, highlight.end - highlight.begin));
+        html += "</mark>";
+        offset = highlight.end;
+    }
+    html += EscapeHtml(text.substr(offset));
+    return html;
+}
+
+std::string GzipCompress(std::string_view data) {
+    z_stream stream{};
+    // 15 window bits, plus 16 for a gzip header and trailer
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) !=
+        Z_OK) {
+        return {};
+    }
+
+    std::string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    int result = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END ? compressed : std::string();
+}
+
+std::string BrotliCompress([[maybe_unused]] std::string_view data) {
+#ifdef SEARCHLIGHT_HAS_BROTLI
+    std::size_t compressed_size = BrotliEncoderMaxCompressedSize(data.size());
+    if (compressed_size == 0) {
+        return {};
+    }
+
+    std::string compressed(compressed_size, '\0');
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               data.size(), reinterpret_cast<const uint8_t *>(data.data()),
+                               &compressed_size, reinterpret_cast<uint8_t *>(compressed.data()))) {
+        return {};
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+#else
+    return {};
+#endif
+}
+
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view encoding) {
+    // An explicit entry takes precedence over "*"
+    std::optional<bool> is_accepted;
+    std::optional<bool> is_wildcard_accepted;
+    anyListElement(accept_encoding, [&](std::string_view element) {
+        std::size_t semicolon = element.find(';');
+        std::string_view name = trim(element.substr(0, semicolon));
+
+        bool has_zero_quality = false;
+        if (semicolon != std::string_view::npos) {
+            std::string_view params = trim(element.substr(semicolon + 1));
+            if (params.starts_with("q=") || params.starts_with("Q=")) {
+                std::string quality(params.substr(2));
+                has_zero_quality = std::strtod(quality.c_str(), nullptr) <= 0.0;
+            }
+        }
+
+        if (equalsIgnoreCase(name, encoding)) {
+            is_accepted = !has_zero_quality;
+        } else if (name == "*") {
+            is_wildcard_accepted = !has_zero_quality;
+        }
+        return false;
+    });
+    return is_accepted.value_or(is_wildcard_accepted.value_or(false));
+}
+
+bool MatchesEtag(std::string_view if_none_match, std::string_view etag) {
+    // If-None-Match uses the weak comparison
+    return anyListElement(if_none_match, [&](std::string_view element) {
+        if (element.starts_with("W/")) {
+            element.remove_prefix(2);
+        }
+        return element == "*" || element == etag;
+    });
+}
+
+std::uint64_t Fnv1aHash(std::string_view data) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace utils